@@ -5,7 +5,7 @@ project "Raymarching"
    targetdir "bin/%{cfg.buildcfg}"
    staticruntime "off"
 
-   files { "src/**.cpp", "screen.frag", "**.hpp", "src/glad.c"}
+   files { "src/**.cpp", "screen.frag", "reproject.vert", "reproject.frag", "example.scene", "**.hpp", "src/glad.c"}
 
    includedirs
    {
@@ -17,8 +17,7 @@ project "Raymarching"
    
 	links 
 	{ 
-		"GLFW",
-		"opengl32.lib"
+		"GLFW"
 	}
 
    targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
@@ -27,6 +26,11 @@ project "Raymarching"
    filter "system:windows"
       systemversion "latest"
       defines { "_PLATFORM_WINDOWS" }
+      links { "opengl32.lib" }
+
+   filter "system:linux"
+      defines { "_PLATFORM_LINUX" }
+      links { "dl", "pthread" }
 
    filter "configurations:Debug"
       defines { "_DEBUG" }
@@ -0,0 +1,9 @@
+#version 330 core
+
+flat in float start;
+
+out float reprojected;
+
+void main() {
+  reprojected = start;
+}
@@ -0,0 +1,61 @@
+#version 330 core
+
+// One point per pixel of last frame's 'hit' target, splatted where that hit lands in the current view.
+// The depth test keeps the nearest, so every covered pixel ends up with a distance that is safe to start marching from.
+
+#define FOV 1.1
+#define FAR 250.
+
+#define MARGIN 0.02 // pulled back by this fraction of the distance
+#define SPLAT 3. // pixels, so neighbours take the minimum and small gaps from camera motion get covered
+#define ANIMATED_SPLAT 8. // moving objects mark this area around where they were to be marched from the camera
+#define ANIMATED(mat) (mat > staticMaterials) // same test as screen.frag, whichever scene it marches
+
+layout(std140) uniform Frame { // Uniforms.h FrameBlock mirrors this, keep the two in sync.
+  vec2 res;
+  float time; // ms
+  float seed;
+
+  vec3 cam;
+  vec3 look;
+
+  vec3 prevCam;
+  float temporal;
+  vec3 prevLook;
+  float frame;
+};
+
+uniform sampler2D historyHit;
+uniform float staticMaterials; // TemporalCache::staticMaterials()
+
+flat out float start;
+
+void main() {
+  ivec2 size = textureSize(historyHit, 0);
+  vec4 hit = texelFetch(historyHit, ivec2(gl_VertexID % size.x, gl_VertexID / size.x), 0);
+
+  // Inverse of LookAt() in screen.frag with the current camera.
+  vec3 v = hit.xyz - cam;
+  vec3 r = normalize(cross(vec3(0, 1, 0), look));
+  vec3 up = cross(r, look);
+
+  float z = dot(v, look);
+  if(z <= 0.) {
+    gl_Position = vec4(2, 2, 2, 1); // clipped
+    return;
+  }
+  vec2 coord = vec2(dot(v, r), -dot(v, up))/(z*FOV)*res.y + 0.5*res;
+  gl_Position.xy = coord/res*2. - 1.;
+  gl_Position.w = 1.;
+
+  if(ANIMATED(hit.w)) {
+    start = 0.;
+    gl_Position.z = -1.;
+    gl_PointSize = ANIMATED_SPLAT;
+  } else {
+    float dist = length(v);
+    start = dist*(1. - MARGIN);
+    gl_Position.z = min(dist/(4.*FAR), 1.)*2. - 1.;
+    gl_PointSize = SPLAT;
+  }
+}
@@ -2,13 +2,24 @@
 
 #define FOV 1.1
 
+// The quality knobs can be set from the command line and are what the quality tiers in ShaderVariants.h set.
+#ifndef STEPS
 #define STEPS 300
+#endif
+#ifndef SHA_STEPS
 #define SHA_STEPS 200
+#endif
 
 #define FAR 250.
 #define NEAR 0.2414
 #define HIT 0.01
 
+// Over-relaxed sphere tracing: steps are RELAXATION times the distance until two spheres in a row fail to overlap,
+// then that ray goes back and continues plainly. 1 is plain sphere tracing. Can be set from the command line.
+#ifndef RELAXATION
+#define RELAXATION 1.
+#endif
+
 #define AMBIENT_PERCENT vec3(0.005)
 
 #define AMBIENT 1.
@@ -18,14 +29,75 @@
 
 #define SPECULAR_FALLOFF 40.
 
-#define BOUNCES 10 
+#ifndef BOUNCES
+#define BOUNCES 10
+#endif
 
+#ifndef FRE
 #define FRE 0
+#endif
 
+#ifndef AO
 #define AO 1
+#endif
+#ifndef AO_SAMPLES
 #define AO_SAMPLES 10.
-
-#define SHADOWS 1
+#endif
+// AO CACHE (AmbientOcclusion.h): every block samples at least once per AO_REFRESH frames, in tiles of AO_TILE blocks.
+// A reused or upsampled occlusion must come from a hit within AO_TOLERANCE of the distance to it.
+#define AO_REFRESH 4
+#define AO_TILE 4
+#define AO_TOLERANCE 0.02
+
+// Bounding volumes in sdf(), see inBound(). 0 evaluates every object exactly everywhere.
+#ifndef BOUNDS
+#define BOUNDS 1
+#endif
+#ifdef BRICK_BAKE // a bound only stands in for distances, the bake wants them exact everywhere
+#undef BOUNDS
+#define BOUNDS 0
+#endif
+#define BOUND_MARGIN 1. // AO reaches 1 away from a hit
+
+// How normal() gets the gradient:
+//   0: forward differences, 3 sdf() calls when the distance at the point is known and 4 otherwise.
+//   1: tetrahedral central differences, 4 sdf() calls, more accurate.
+//   2: analytic gradients of the sphere, box and torus primitives in one pass over the scene; the mirrors and the
+//      icosahedron have none and fall back to 1, and so does a scene file.
+#ifndef NORMALS
+#define NORMALS 0
+#endif
+#define NORMAL_DELTA 0.01
+
+// Soft shadows from the lights nearest to each hit, see softShadow(). SHADOW_LIGHTS of them per primary hit and
+// SHADOW_BOUNCE_LIGHTS per reflected one, however many reach it. The shadow cache (ShadowCache.h) holds one vec4 per tile.
+#ifndef SHADOWS
+#define SHADOWS 0
+#endif
+#define SHADOW_LIGHTS 4
+#define SHADOW_BOUNCE_LIGHTS 1
+#define SHADOW_SOFTNESS 8. // larger is harder
+#define SHADOW_BIAS 0.05 // off the surface along the normal, so the march doesn't start inside it
+#define SHADOW_PACK 0.999 // cache slots hold light index + SHADOW_PACK*visibility
+#define SHADOW_AGREE 0.05 // how far apart the tiles around a pixel may see a light and still stand in for its own shadow ray
+
+#define TEMPORAL_REFRESH 4 // every pixel marches from the camera at least once per this many frames
+#define TEMPORAL_TILE 8
+#define TEMPORAL_BLEND 0.25 // weight of the new frame when accumulating
+#define TEMPORAL_TOLERANCE 0.02 // how far a reprojected hit may move, relative to its distance, and still count as the same surface
+#define ANIMATED(mat) (mat > 1.) // everything but the ground moves. reproject.vert gets the count from TemporalCache
+#define CHECKERED(id) (id == 1) // the ground. A scene file redefines both
+
+#define CONE_STEPS 200
+
+// BRICK MAP (BrickMap.h): with BRICKS defined the mirrors and the icosahedron come out of a baked sparse distance field
+// instead of their sdfs, so they stop animating and hold still at STATIC_TIME. BRICK_BAKE builds the program that bakes it.
+#define BRICK_SAMPLES 8 // per brick edge, one more than its voxels so neighbouring bricks share their faces
+#if defined(BRICKS) || defined(BRICK_BAKE)
+#define STATIC_TIME 0.
+#else
+#define STATIC_TIME time
+#endif
 
 #define PI 3.141592
 #define TAU 6.283184
@@ -33,21 +105,84 @@
 #define sat(a) clamp(a, 0., 1.)
 #define material(index) materials[index-1]
 
-out vec3 col;
+layout(location = 0) out vec3 col;
+layout(location = 1) out vec4 hit; // primary hit for the temporal cache: xyz world position, w material (0 for sky)
+
+layout(std140) uniform Frame { // Uniforms.h FrameBlock mirrors this, keep the two in sync.
+  vec2 res;
+  float time; // ms
+  float seed;
+
+  vec3 cam;
+  vec3 look;
+
+  // TEMPORAL: the camera the history was rendered with. temporal is 0 when there's no usable history.
+  vec3 prevCam;
+  float temporal;
+  vec3 prevLook;
+  float frame;
+};
 
-uniform vec2 res;
-uniform int time;
-uniform float seed;
+uniform sampler2D historyColor; // last frame's accumulated color
+uniform sampler2D historyHit; // last frame's 'hit'
+uniform sampler2D reprojected; // distance the primary ray can safely start marching at, 0 if unknown
+
+// CONE PREPASS: per coneTile x coneTile tile, the distance every primary ray in it can start at. coneTile is 0 without one.
+uniform sampler2D coneDepth;
+uniform float coneTile;
+
+// AO CACHE: per aoScale x aoScale block the primary hit through its center in xyz and that hit's occlusion in w, -1 for
+// sky. aoScale is 0 without one. The AO pass itself reads last frame's from aoHistory, seen from aoPrevCam.
+uniform sampler2D aoCache;
+uniform float aoScale;
+uniform sampler2D aoHistory;
+uniform vec3 aoPrevCam;
+uniform vec3 aoPrevLook;
+uniform float aoValid;
+uniform float aoFrame;
+
+// SHADOW CACHE: per shadowTile x shadowTile tile up to SHADOW_LIGHTS slots of light index + SHADOW_PACK*visibility at the
+// hit through the tile's center, -1 for none. shadowTile is 0 without one.
+uniform sampler2D shadowCache;
+uniform float shadowTile;
+
+// BRICK MAP: brickIndex has one texel per brick of the grid, the atlas slot and material of a brick near a surface, or
+// x -1, the distance at the brick's center in y and the material in z. brickAtlas holds the samples.
+uniform sampler3D brickIndex;
+uniform sampler3D brickAtlas;
+uniform vec3 brickOrigin;
+uniform vec3 brickGrid;
+uniform float brickVoxel;
+
+// LIGHTS: animated and sorted into clusters on the CPU once a frame, see LightBuffer.h. clusterLights holds every
+// cell's offset and count at 2*cell and 2*cell+1, then the light indices.
+#define MAX_LIGHTS 256
+#define CLUSTER_DIM ivec3(12, 8, 12)
+struct PointLight {
+  vec3 pos;
+  float radius;
+  vec4 col;
+};
+layout(std140) uniform Lights { // LightBuffer.h LightBlock mirrors this, keep the two in sync.
+  vec3 clusterMin;
+  int lightCount;
+  vec3 clusterCell;
+  PointLight lights[MAX_LIGHTS];
+};
+uniform usamplerBuffer clusterLights;
 
-uniform vec3 cam;
-uniform vec3 look;
+float primaryStart = 0.;
+vec4 primaryHit = vec4(0);
+int marchSteps = 0; // every trace() step of this pixel, written out instead of the color with STEP_COUNT defined
 
 struct Material { // IF ROUGH == 0 || IREF <= 1 it's reflective. IF ROUGH < 1 && IREF > 1 ITS REFRACTIVE
     vec4 albedo;
     float rough;
     float metal;
     float iref;
-} materials[] = Material[](
+};
+#ifndef SCENE
+Material materials[] = Material[](
     Material(vec4(0.7,0.7,0.7, 0), 1., 3., 0.),
     Material(vec4(0.6,0.01,0.01, 0), 1., 0.01, 0.),
     Material(vec4(1,1,1, 0.02), 1., 1., 0.), // Spinny thing
@@ -55,6 +190,7 @@ struct Material { // IF ROUGH == 0 || IREF <= 1 it's reflective. IF ROUGH < 1 &&
     Material(vec4(0,0,0, 0), 0., 1., 0.),
     Material(vec4(0,0,0, 0), 0.8, 1., 1.6)
 );
+#endif
 
 struct Ray {
   vec3 ro, rd;
@@ -65,16 +201,6 @@ struct Ray {
   Material mat;
 };
 
-struct PointLight {
-    vec3 pos;
-    vec4 col;
-    float radius;
-} lights[] = PointLight[](
-    PointLight(5.*vec3(sin(PI/3.), 2, cos(PI/3.)), vec4(0, 0, 1, 1), 160.),
-    PointLight(5.*vec3(sin(2.*PI/3.), 2, cos(2.*PI/3.)), vec4(1, 0, 0, 1), 160.),
-    PointLight(5.*vec3(0., 2, 1.), vec4(0, 1, 0, 1), 160.)
-);
-float recipLights = 1./lights.length();
 
 mat2 rotationMatrix(in float angle) {
     float s = sin(angle), c = cos(angle);
@@ -121,11 +247,210 @@ float sdfRhombicIcos(in vec3 p, in float r) {
   p.xy = abs(p.xy);
   p -= 2.*min(0., dot(p, n))*n;
 
-  return p.z-1.;
+  return p.z-r;
+}
+// BOUNDING VOLUMES: every object sits in a bounding sphere, and the spinner, mirrors and icosahedron share one more
+// around all three. A bound no nearer than the best distance so far skips what's inside it, a bound further than
+// BOUND_MARGIN stands in for it, so only objects within BOUND_MARGIN of p get their exact sdf. Anything that looks
+// at the sdf closer to a surface than that, like normals and AO, sees exact values.
+// Skipping code only pays on hardware that branches; a software rasterizer that runs both sides of every if is
+// faster with BOUNDS 0.
+bool inBound(inout float[2] data, in float bound, in float mat) {
+  if(BOUNDS == 0)
+    return true;
+  if(bound >= data[0])
+    return false;
+  if(bound > BOUND_MARGIN) {
+    data = float[](bound, mat);
+    return false;
+  }
+  return true;
+}
+
+// The part of the scene the brick map bakes: the mirrors and the icosahedron, moving with STATIC_TIME.
+void sdfStatic(in vec3 p, inout float[2] data) {
+  // MIRRORS
+    vec3 mirpos = p - vec3(0, 9, 0);
+        
+    mirpos.xz = abs(mirpos.xz)-vec2(5);
+
+    // 3.5 holds the box, its rounding and the wobble, around the nearest of the four.
+    if(inBound(data, sdfSphere(mirpos, 3.5), 4.)) {
+      mirpos.xz *= rotationMatrix(PI/4.);
+      mirpos.zy *= rotationMatrix(-PI/6.);
+
+      mirpos.y += 0.5*sin(mirpos.x*mirpos.z+STATIC_TIME*0.003);
+
+      float mir = sdfBox(mirpos, vec3(1.8+0.1*sin(TAU*mirpos.y*mirpos.z+STATIC_TIME*0.005), 2, 0.3))-0.2;
+      if(mir < data[0]) {
+        data[0] = mir*0.5;
+        data[1] = 4.;
+      }
+    }
+
+  // RHOMBIC ICOSAHEDRON
+    vec3 icosp = p - vec3(0, 10, 0);
+    if(inBound(data, sdfSphere(icosp, 1.2), 6.)) {
+      icosp.xz *= rotationMatrix(STATIC_TIME*0.001);
+      float icos = sdfRhombicIcos(icosp, 1.);
+      if(icos < data[0]) {
+        data[0] = icos;
+        data[1] = 6.;
+      }
+    }
+}
+
+// Samples the baked sdfStatic(). Outside the grid it looks up q, the nearest point on it: every surface is inside, so
+// none is nearer than the way to q and the distance at q put together at a right angle.
+void sdfBaked(in vec3 p, inout float[2] data) {
+  float brick = float(BRICK_SAMPLES-1)*brickVoxel;
+  vec3 size = brickGrid*brick;
+  vec3 q = clamp(p, brickOrigin, brickOrigin + size);
+  float outside = length(p - q);
+  if(outside >= data[0])
+    return;
+
+  vec3 cell = (q - brickOrigin)/brick;
+  vec4 index = texelFetch(brickIndex, min(ivec3(cell), ivec3(brickGrid)-1), 0);
+  float d, mat;
+  if(index.x < 0.) { // far from any surface, nothing is nearer than the center's distance less the way there
+    float toCenter = length(fract(cell) - 0.5)*brick;
+    d = index.y > 0. ? index.y - toCenter : index.y + toCenter;
+    mat = index.z;
+  }
+  else {
+    vec3 local = fract(cell)*float(BRICK_SAMPLES-1) + 0.5;
+    d = texture(brickAtlas, (index.xyz*float(BRICK_SAMPLES) + local)/vec3(textureSize(brickAtlas, 0))).r;
+    mat = index.w;
+  }
+  if(outside > 0.)
+    d = length(vec2(outside, d)); // the border bricks are all empty, d is positive there
+
+  if(d < data[0])
+    data = float[](d, mat);
+}
+
+#ifdef SCENE_INTERPRETER
+// SCENE BYTECODE (SceneInterpreter.h): the header in texel 0, then two texels per instruction, then two per material.
+// The instructions work on 'nearest': primitives min into it, PUSH saves it for the shapes of an operation to start
+// over, the operations combine what's on the stack with it, and MERGE mins the result back into what was saved.
+// SCALE starts over from the saved distance scaled down like the compiled scene does. Transforms save the point.
+#define SCENE_STACK 8
+#define OP_SPHERE 1
+#define OP_BOX 2
+#define OP_TORUS 3
+#define OP_SLAB 4
+#define OP_ICOSAHEDRON 5
+#define OP_TRANSLATE 10
+#define OP_ROTATE 11
+#define OP_MIRROR 12
+#define OP_POP 13
+#define OP_BOUND 20
+#define OP_PUSH 30
+#define OP_SCALE 31
+#define OP_UNSCALE 32
+#define OP_INTERSECT 40
+#define OP_SUBTRACT 41
+#define OP_SMOOTH 42
+#define OP_MORPH 43
+#define OP_MERGE 44
+uniform samplerBuffer sceneCode;
+
+Material sceneMaterial(in int index) {
+  int at = int(texelFetch(sceneCode, 0).y) + 2*(index-1);
+  vec4 t = texelFetch(sceneCode, at + 1);
+  return Material(texelFetch(sceneCode, at), t.x, t.y, t.z);
+}
+#undef material
+#define material(index) sceneMaterial(index)
+#undef ANIMATED
+#define ANIMATED(mat) (mat > texelFetch(sceneCode, 0).z)
+#undef CHECKERED
+#define CHECKERED(id) (texelFetch(sceneCode, int(texelFetch(sceneCode, 0).y) + 2*(id) - 1).w > 0.)
+
+void sceneSdf(in vec3 p, inout float[2] data) {
+  vec3 points[SCENE_STACK];
+  vec2 stack[SCENE_STACK]; // distance, material
+  int pointTop = 0, top = 0;
+  vec2 nearest = vec2(data[0], data[1]);
+
+  int end = int(texelFetch(sceneCode, 0).x);
+  for(int pc = 1; pc < end; pc += 2) {
+    vec4 op = texelFetch(sceneCode, pc), arg = texelFetch(sceneCode, pc + 1);
+    int code = int(op.x);
+    if(code < OP_TRANSLATE) {
+      float d;
+      if(code == OP_SPHERE) d = sdfSphere(p, arg.x);
+      else if(code == OP_BOX) d = sdfBox(p, arg.xyz) - arg.w;
+      else if(code == OP_TORUS) d = sdfTorus(p, arg.x, arg.y);
+      else if(code == OP_SLAB) d = abs(p[int(op.z)] - arg.x) - arg.y;
+      else d = sdfRhombicIcos(p, 1.);
+      if(d < nearest.x) nearest = vec2(d, op.y);
+    }
+    else if(code < OP_BOUND) {
+      if(code == OP_POP) {
+        p = points[--pointTop];
+        continue;
+      }
+      points[pointTop++] = p;
+      if(code == OP_TRANSLATE) p -= arg.xyz;
+      else if(code == OP_MIRROR) p = mix(p, abs(p), arg.xyz);
+      else { // p.ab *= mat2(c, -s, s, c)
+        int a = int(op.y), b = int(op.z);
+        vec2 q = vec2(p[a], p[b]);
+        p[a] = arg.x*q.x - arg.y*q.y;
+        p[b] = arg.y*q.x + arg.x*q.y;
+      }
+    }
+    else if(code == OP_BOUND) {
+      float[2] bounded = float[](nearest.x, nearest.y);
+      if(!inBound(bounded, sdfSphere(p - arg.xyz, arg.w), op.y))
+        pc += 2*int(op.z);
+      nearest = vec2(bounded[0], bounded[1]);
+    }
+    else if(code == OP_PUSH) {
+      stack[top++] = nearest;
+      nearest = vec2(FAR, 0);
+    }
+    else if(code == OP_SCALE) {
+      stack[top++] = nearest;
+      nearest.x /= arg.x;
+      if(op.y > 0.) {
+        points[pointTop++] = p;
+        p /= arg.x;
+      }
+    }
+    else if(code == OP_UNSCALE) {
+      top--;
+      nearest.x *= arg.x;
+      if(op.y > 0.)
+        p = points[--pointTop];
+    }
+    else {
+      vec2 a = stack[--top];
+      if(code == OP_INTERSECT) nearest = a.x > nearest.x ? a : nearest;
+      else if(code == OP_SUBTRACT) nearest = vec2(max(a.x, -nearest.x), a.y);
+      else if(code == OP_SMOOTH) {
+        float h = clamp(0.5 + 0.5*(nearest.x - a.x)/arg.x, 0., 1.);
+        nearest = vec2(mix(nearest.x, a.x, h) - arg.x*h*(1. - h), h > 0.5 ? a.y : nearest.y);
+      }
+      else if(code == OP_MORPH) nearest = vec2(mix(a.x, nearest.x, arg.x), arg.x < 0.5 ? a.y : nearest.y);
+      else nearest = a.x < nearest.x ? a : nearest; // OP_MERGE
+    }
+  }
+  data = float[](nearest.x, nearest.y);
 }
+#elif defined(SCENE)
+// SCENE FILE: its materials[] and sceneSdf() go here, see SceneCompiler.h.
+#pragma scene
+#endif
+
 float[2] sdf(in vec3 p) {
   float[2] data = float[](FAR, 0);
     
+#ifdef SCENE
+  sceneSdf(p, data);
+#else
   // SCENE BUILD
     
   // GROUND
@@ -134,121 +459,233 @@ float[2] sdf(in vec3 p) {
       data[0] = ground;
       data[1] = 1.;
     }
-    
+
+  if(inBound(data, sdfSphere(p - vec3(0, 6, 0), 11.2), 4.)) {
   // SPINNER
+    if(inBound(data, sdfSphere(p, 2.2), 3.)) {
     // BALL
-    vec3 spinnerPos = p;
-    spinnerPos.y += 0.1*sin(time*TAU*0.0004);
-    float ball = sdfSphere(spinnerPos, 1.);
-    if(ball < data[0]) {
-      data[0] = ball;
-      data[1] = 2.;
-    }
+      vec3 spinnerPos = p;
+      spinnerPos.y += 0.1*sin(time*TAU*0.0004);
+      float ball = sdfSphere(spinnerPos, 1.);
+      if(ball < data[0]) {
+        data[0] = ball;
+        data[1] = 2.;
+      }
     // RINGS
-    spinnerPos.xy *= rotationMatrix(time*0.0014286);
-    spinnerPos.zy *= rotationMatrix(time*0.0025);
-    float ring = sdfTorus(spinnerPos, 1.5, 0.1);
-    if(ring < data[0]) {
-      data[0] = ring;
-      data[1] = 3.;
-    }
-    spinnerPos.xy *= rotationMatrix(-6.*sin(time*0.0005263));
-    spinnerPos.zy *= rotationMatrix(time*0.001);
-    ring = sdfTorus(spinnerPos, 2., 0.1);
-    if(ring < data[0]) {
-      data[0] = ring;
-      data[1] = 3.;
+      spinnerPos.xy *= rotationMatrix(time*0.0014286);
+      spinnerPos.zy *= rotationMatrix(time*0.0025);
+      float ring = sdfTorus(spinnerPos, 1.5, 0.1);
+      if(ring < data[0]) {
+        data[0] = ring;
+        data[1] = 3.;
+      }
+      spinnerPos.xy *= rotationMatrix(-6.*sin(time*0.0005263));
+      spinnerPos.zy *= rotationMatrix(time*0.001);
+      ring = sdfTorus(spinnerPos, 2., 0.1);
+      if(ring < data[0]) {
+        data[0] = ring;
+        data[1] = 3.;
+      }
     }
     
-  // MIRRORS
-    vec3 mirpos = p - vec3(0, 9, 0);
-        
-    mirpos.xz = abs(mirpos.xz)-vec2(5);
-
-    mirpos.xz *= rotationMatrix(PI/4.);
-    mirpos.zy *= rotationMatrix(-PI/6.);
-
-    mirpos.y += 0.5*sin(mirpos.x*mirpos.z+time*0.003);
-
-    float mir = sdfBox(mirpos, vec3(1.8+0.1*sin(TAU*mirpos.y*mirpos.z+time*0.005), 2, 0.3))-0.2;
-    if(mir < data[0]) {
-      data[0] = mir*0.5;
-      data[1] = 4.;
-    }
+#ifndef BRICKS
+    sdfStatic(p, data);
+#endif
+  }
+#ifdef BRICKS
+  sdfBaked(p, data);
+#endif
   
   // MORPHING BOX
     vec3 mpos = p - vec3(10, -6, 0);
-    float box = sdfBox(mpos, vec3(1.8))-0.2;
-    float sphere = sdfSphere(mpos, 2.);
-
-    float morph = mix(box, sphere, smoothstep(-.2, 1., sin(time*0.002)));
-    if(morph < data[0]) {
-      data[0] = morph*0.9;
-      data[1] = 6.;
-    }
-
-  // RHOMBIC ICOSAHEDRON
-    vec3 icosp = p - vec3(0, 10, 0);
-    icosp.xz *= rotationMatrix(time*0.001);
-    float icos = sdfRhombicIcos(icosp, 1.);
-    if(icos < data[0]) {
-      data[0] = icos;
-      data[1] = 6.;
+    if(inBound(data, sdfSphere(mpos, 3.4), 6.)) {
+      float box = sdfBox(mpos, vec3(1.8))-0.2;
+      float sphere = sdfSphere(mpos, 2.);
+
+      float morph = mix(box, sphere, smoothstep(-.2, 1., sin(time*0.002)));
+      if(morph < data[0]) {
+        data[0] = morph*0.9;
+        data[1] = 6.;
+      }
     }
   // END SCENE
+#endif
 
   // performance gets mega bad when you intersect objects without a near plane. Also the near plane is fun and quirky.
   return float[](max(data[0], (NEAR-length(p-cam)*0.9)), data[1]); // NEAR PLANE
   // return data; // NO NEAR PLANE
 }
 
-vec3 normal(in vec3 point) {
-    vec2 delta = vec2(0.01, 0);
+vec3 normalForward(in vec3 point, in float d) {
+    vec2 delta = vec2(NORMAL_DELTA, 0);
     vec3 gradient = vec3(
         sdf(point - delta.xyy)[0],
         sdf(point - delta.yxy)[0],
         sdf(point - delta.yyx)[0]
     );
-  return normalize(sdf(point)[0] - gradient);
+  return normalize(d - gradient);
+}
+vec3 normalTetrahedral(in vec3 point) {
+  // Corners of a tetrahedron around the point, NORMAL_DELTA away. Their weighted sum is a central difference.
+  vec2 k = vec2(1, -1);
+  float h = NORMAL_DELTA*0.5773;
+  return normalize(
+    k.xyy*sdf(point + k.xyy*h)[0] +
+    k.yyx*sdf(point + k.yyx*h)[0] +
+    k.yxy*sdf(point + k.yxy*h)[0] +
+    k.xxx*sdf(point + k.xxx*h)[0]
+  );
+}
+
+vec3 gradBox(in vec3 p, in vec3 s) {
+  vec3 q = abs(p) - s;
+  if(max(q.x, max(q.y, q.z)) > 0.)
+    return sign(p)*normalize(max(q, 0.));
+  return sign(p)*step(q.yzx, q)*step(q.zxy, q); // inside, the axis of the nearest face
+}
+vec3 gradTorus(in vec3 p, in float r1) {
+  vec2 q = vec2(length(p.xy)-r1, p.z);
+  return normalize(vec3(normalize(p.xy)*q.x, q.y));
+}
+// The scene of sdf() again, keeping the gradient of whatever is nearest. Keep the two in sync. Rotations are undone
+// on the gradient in reverse order: v.xy *= m is m transposed times v, so its inverse is m times v.
+vec3 normalAnalytic(in vec3 p) {
+  float d = abs(p.y+10.)-0.015;
+  vec3 g = vec3(0, sign(p.y+10.), 0);
+  bool closed = true;
+
+  // SPINNER
+  vec3 spinnerPos = p;
+  spinnerPos.y += 0.1*sin(time*TAU*0.0004);
+  float ball = sdfSphere(spinnerPos, 1.);
+  if(ball < d) {
+    d = ball;
+    g = normalize(spinnerPos);
+  }
+  mat2 m1 = rotationMatrix(time*0.0014286), m2 = rotationMatrix(time*0.0025);
+  spinnerPos.xy *= m1;
+  spinnerPos.zy *= m2;
+  float ring = sdfTorus(spinnerPos, 1.5, 0.1);
+  if(ring < d) {
+    d = ring;
+    g = gradTorus(spinnerPos, 1.5);
+    g.zy = m2*g.zy;
+    g.xy = m1*g.xy;
+  }
+  mat2 m3 = rotationMatrix(-6.*sin(time*0.0005263)), m4 = rotationMatrix(time*0.001);
+  spinnerPos.xy *= m3;
+  spinnerPos.zy *= m4;
+  ring = sdfTorus(spinnerPos, 2., 0.1);
+  if(ring < d) {
+    d = ring;
+    g = gradTorus(spinnerPos, 2.);
+    g.zy = m4*g.zy;
+    g.xy = m3*g.xy;
+    g.zy = m2*g.zy;
+    g.xy = m1*g.xy;
+  }
+
+  // MIRRORS
+  vec3 mirpos = p - vec3(0, 9, 0);
+  mirpos.xz = abs(mirpos.xz)-vec2(5);
+  mirpos.xz *= rotationMatrix(PI/4.);
+  mirpos.zy *= rotationMatrix(-PI/6.);
+  mirpos.y += 0.5*sin(mirpos.x*mirpos.z+STATIC_TIME*0.003);
+  float mir = sdfBox(mirpos, vec3(1.8+0.1*sin(TAU*mirpos.y*mirpos.z+STATIC_TIME*0.005), 2, 0.3))-0.2;
+  if(mir < d) {
+    d = mir*0.5;
+    closed = false;
+  }
+
+  // RHOMBIC ICOSAHEDRON
+  vec3 icosp = p - vec3(0, 10, 0);
+  icosp.xz *= rotationMatrix(STATIC_TIME*0.001);
+  float icos = sdfRhombicIcos(icosp, 1.);
+  if(icos < d) {
+    d = icos;
+    closed = false;
+  }
+
+  // MORPHING BOX
+  vec3 mpos = p - vec3(10, -6, 0);
+  float blend = smoothstep(-.2, 1., sin(time*0.002));
+  float morph = mix(sdfBox(mpos, vec3(1.8))-0.2, sdfSphere(mpos, 2.), blend);
+  if(morph < d) {
+    d = morph*0.9;
+    g = mix(gradBox(mpos, vec3(1.8)), normalize(mpos), blend);
+    closed = true;
+  }
+
+  // NEAR PLANE
+  if(NEAR-length(p-cam)*0.9 > d) {
+    g = cam - p;
+    closed = true;
+  }
+
+  return closed ? normalize(g) : normalTetrahedral(p);
 }
+
+// d is the sdf at the point, only forward differences use it.
 vec3 normal(in vec3 point, in float d) {
-    vec2 delta = vec2(0.01, 0);
-    vec3 gradient = vec3(
-        sdf(point - delta.xyy)[0],
-        sdf(point - delta.yxy)[0],
-        sdf(point - delta.yyx)[0]
-    );
-  return normalize(d - gradient);
+#if NORMALS == 1
+  return normalTetrahedral(point);
+#elif NORMALS == 2 && !defined(SCENE)
+  return normalAnalytic(point);
+#elif NORMALS == 2
+  return normalTetrahedral(point);
+#else
+  return normalForward(point, d);
+#endif
+}
+vec3 normal(in vec3 point) {
+#if NORMALS == 0
+  return normalForward(point, sdf(point)[0]);
+#else
+  return normal(point, 0.);
+#endif
 }
 
-float[3] trace(in vec3 ro, in vec3 rd, in int steps, in float side) {
-    float dist = 0.;
+float[3] trace(in vec3 ro, in vec3 rd, in int steps, in float side, in float start) {
+    float dist = start;
+    float omega = RELAXATION, stepLength = 0., prevRadius = 0.;
     
     float[2] data;
     for(int i = 0; i < steps; i++) {
         data = sdf(ro + rd*dist);
         data[0] *= side;
-
-        if(abs(data[0]) < HIT || dist > FAR) 
+        marchSteps++;
+
+        float radius = abs(data[0]);
+        if(omega > 1. && radius + prevRadius < stepLength) {
+            // The relaxed step left a gap a surface could hide in. Redo it as a plain step and stay plain.
+            dist -= stepLength - prevRadius;
+            stepLength = prevRadius;
+            omega = 1.;
+            continue;
+        }
+
+        if(radius < HIT || dist > FAR) 
             break;
 
-        dist += data[0];
+        stepLength = data[0]*omega;
+        prevRadius = radius;
+        dist += stepLength;
     }
     return float[3](dist, data[1], data[0]); // 0: distance to scene along ray  1: materialID
 }
+float[3] trace(in vec3 ro, in vec3 rd, in int steps, in float side) {
+    return trace(ro, rd, steps, side, 0.);
+}
 
 vec3 getTexel(in int matID, in Material mat, in vec3 p) {
-  switch(matID) {
-    //case :
-    //  return normal(p)*0.5+0.5;
-    case 0:
-      return vec3(0);
-    case 1:
-      p.xz *= rotationMatrix(PI/4.);
-      return material(1).albedo.rgb*(0.5+0.5*ceil(clamp(vec3(sin(1.5*p.x)+sin(1.5*p.z)), 0., 1.)));
-    default:
-      return material(matID).albedo.rgb;
-    }
+  //return normal(p)*0.5+0.5;
+  if(matID == 0)
+    return vec3(0);
+  if(CHECKERED(matID)) {
+    p.xz *= rotationMatrix(PI/4.);
+    return material(matID).albedo.rgb*(0.5+0.5*ceil(clamp(vec3(sin(1.5*p.x)+sin(1.5*p.z)), 0., 1.)));
+  }
+  return material(matID).albedo.rgb;
  }
 
 float calculateAO(vec3 p, vec3 n){
@@ -263,30 +700,140 @@ float calculateAO(vec3 p, vec3 n){
     return 1.0-clamp(r,0.0,1.0);
 }
 
+// The cached occlusion of this pixel's primary hit: the four nearest blocks, weighted bilinearly and dropped unless
+// their hit lies on the plane of this one. -1 when none does.
+float cachedAO(in vec3 p, in vec3 n) {
+  vec2 t = gl_FragCoord.xy/aoScale - 0.5;
+  ivec2 base = ivec2(floor(t)), last = textureSize(aoCache, 0) - 1;
+  vec2 f = fract(t);
+  float tolerance = AO_TOLERANCE*distance(p, cam);
+
+  float sum = 0., weight = 0.;
+  for(int i = 0; i < 4; i++) {
+    ivec2 o = ivec2(i & 1, i >> 1);
+    vec4 block = texelFetch(aoCache, clamp(base + o, ivec2(0), last), 0);
+    if(block.w < 0. || abs(dot(n, block.xyz - p)) > tolerance)
+      continue;
+    // Never quite 0, so a lone block on the same surface still counts.
+    float w = mix(1. - f.x, f.x, float(o.x))*mix(1. - f.y, f.y, float(o.y)) + 1e-3;
+    sum += w*block.w;
+    weight += w;
+  }
+  return weight > 0. ? sum/weight : -1.;
+}
+
+// Where the light list of the cluster holding p starts in clusterLights, and its length.
+ivec2 clusterRange(in vec3 p) {
+  ivec3 cell = clamp(ivec3(floor((p - clusterMin)/clusterCell)), ivec3(0), CLUSTER_DIM - 1);
+  int cluster = 2*(cell.x + CLUSTER_DIM.x*(cell.y + CLUSTER_DIM.y*cell.z));
+  return ivec2(texelFetch(clusterLights, cluster).r, texelFetch(clusterLights, cluster + 1).r);
+}
+float lightFalloff(in float lightDistance, in float radius) {
+  // Fades out towards the radius so a light's cut off doesn't show.
+  float fade = sat(1. - pow(lightDistance/radius, 4.));
+  return fade*fade/(lightDistance*0.5);
+}
+
+// Penumbra estimate along a shadow ray: how close the ray passes to anything, relative to how far along it is. Stops
+// as soon as the ray is fully blocked or reaches the light.
+float softShadow(in vec3 ro, in vec3 rd, in float maxt) {
+  float res = 1., t = HIT;
+  for(int i = 0; i < SHA_STEPS && t < maxt; i++) {
+    float h = sdf(ro + rd*t)[0];
+    res = min(res, SHADOW_SOFTNESS*h/t);
+    if(res < HIT)
+      return 0.;
+    t += clamp(h, HIT, 2.);
+  }
+  return smoothstep(0., 1., res);
+}
+
+// The budget lights that light p the most, strongest first, -1 for empty slots. Only they cast shadows.
+ivec4 pickShadowLights(in vec3 p, in vec3 n, in int budget) {
+  ivec4 picked = ivec4(-1);
+  vec4 strength = vec4(0);
+  ivec2 range = clusterRange(p);
+  for(int k = 0; k < range.y; k++) {
+    int i = int(texelFetch(clusterLights, range.x + k).r);
+    vec3 lightVector = lights[i].pos - p;
+    float lightDistance = length(lightVector);
+    if(lightDistance > lights[i].radius || dot(n, lightVector) <= 0.) continue;
+
+    float w = lightFalloff(lightDistance, lights[i].radius)*lights[i].col.a*max(lights[i].col.r, max(lights[i].col.g, lights[i].col.b));
+    for(int s = 0; s < SHADOW_LIGHTS; s++) {
+      if(s >= budget || w <= strength[s]) continue;
+      float ws = strength[s];
+      int is = picked[s];
+      strength[s] = w;
+      picked[s] = i;
+      w = ws;
+      i = is;
+    }
+  }
+  return picked;
+}
+
+// What the shadow cache says about light i at this pixel: the four nearest tiles' visibility of it, interpolated
+// bilinearly, when they agree to within SHADOW_AGREE. Fully lit or fully shadowed areas always agree, and so do the
+// smooth middles of wide penumbrae. -1 when they disagree or one of them didn't look at the light.
+float cachedShadow(in int i) {
+  vec2 t = gl_FragCoord.xy/shadowTile - 0.5;
+  ivec2 base = ivec2(floor(t)), last = textureSize(shadowCache, 0) - 1;
+  vec2 f = fract(t);
+
+  vec4 v = vec4(-1);
+  for(int j = 0; j < 4; j++) {
+    vec4 slots = texelFetch(shadowCache, clamp(base + ivec2(j & 1, j >> 1), ivec2(0), last), 0);
+    for(int s = 0; s < SHADOW_LIGHTS; s++)
+      if(slots[s] >= 0. && int(slots[s]) == i)
+        v[j] = fract(slots[s])/SHADOW_PACK;
+    if(v[j] < 0.)
+      return -1.;
+  }
+  float lo = min(min(v.x, v.y), min(v.z, v.w)), hi = max(max(v.x, v.y), max(v.z, v.w));
+  if(hi - lo > SHADOW_AGREE)
+    return -1.;
+  return mix(mix(v.x, v.y, f.x), mix(v.z, v.w, f.x), f.y);
+}
+float shadow(in Ray ray, in int i, in vec3 lightVector, in float lightDistance) {
+  float v = ray.bounces == 0 && shadowTile > 0. ? cachedShadow(i) : -1.;
+  return v >= 0. ? v : softShadow(ray.hitp + ray.hitn*SHADOW_BIAS, lightVector, lightDistance);
+}
+
 vec3 lighting(in Ray ray, in vec3 texel) {
-  vec3 ambient = AMBIENT_PERCENT, diffuse, specular;
-  for(int i = 0; i < lights.length(); i++) {
+  vec3 ambient = AMBIENT_PERCENT, diffuse = vec3(0), specular = vec3(0);
+  ivec4 shadowed = ivec4(-1);
+  if(SHADOWS == 1)
+    shadowed = pickShadowLights(ray.hitp, ray.hitn, ray.bounces == 0 ? SHADOW_LIGHTS : SHADOW_BOUNCE_LIGHTS);
+
+  ivec2 range = clusterRange(ray.hitp);
+  for(int k = 0; k < range.y; k++) {
+    int i = int(texelFetch(clusterLights, range.x + k).r);
     vec3 lightVector = lights[i].pos - ray.hitp;
     float lightDistance = length(lightVector);
 
-    if(lightDistance > lights[i].radius + length(lights[i].pos - ray.ro)) continue;
+    if(lightDistance > lights[i].radius) continue;
 
     lightVector = normalize(lightVector);
 
-    float attenuation = 1./(lightDistance*0.5);
+    float attenuation = lightFalloff(lightDistance, lights[i].radius);
+    float visible = any(equal(shadowed, ivec4(i))) ? shadow(ray, i, lightVector, lightDistance) : 1.;
 
     ambient += lights[i].col.rgb*attenuation;
-    diffuse += lights[i].col.rgb*sat(dot(ray.hitn, lightVector))*lights[i].col.a*attenuation;
+    diffuse += lights[i].col.rgb*sat(dot(ray.hitn, lightVector))*lights[i].col.a*attenuation*visible;
 
     vec3 halfway = normalize(normalize(ray.ro - ray.hitp) + lightVector);
     float specularIntensity = pow(sat(dot(ray.hitn, halfway)), max(ray.mat.metal*SPECULAR_FALLOFF, 1.));
-    specular += lights[i].col.rgb*lights[i].col.a*specularIntensity*attenuation;
+    specular += lights[i].col.rgb*lights[i].col.a*specularIntensity*attenuation*visible;
   }
   //specular = sat(specular);
 
   float occ = 1.;
-  if(AO == 1) 
-    occ = calculateAO(ray.hitp, ray.hitn);
+  if(AO == 1) {
+    occ = ray.bounces == 0 && aoScale > 0. ? cachedAO(ray.hitp, ray.hitn) : -1.;
+    if(occ < 0.)
+      occ = calculateAO(ray.hitp, ray.hitn);
+  }
 
   vec3 global = occ*(AMBIENT*ambient + DIFFUSE*diffuse + SPECULAR*specular) + EMISSIVE*ray.mat.albedo.a;
   return texel*global;
@@ -347,18 +894,23 @@ void refractt(inout Ray ray) {
   ray.ro -= ray.hitn*HIT*4.;
 }
 
-vec3 bounce(inout Ray ray) {
-  vec3 bg = bgcol(ray.rd);
-  
-  ray.hit = trace(ray.ro, ray.rd, STEPS, 1.);
+// Marches the ray and fills in where it hit. False for sky.
+bool march(inout Ray ray) {
+  ray.hit = trace(ray.ro, ray.rd, STEPS, 1., ray.bounces == 0 ? primaryStart : 0.);
+  if(ray.bounces == 0) // sky is kept as a point far past the scene so it reprojects by direction
+    primaryHit = ray.hit[0] > FAR ? vec4(ray.ro + ray.rd*2.*FAR, 0) : vec4(ray.ro + ray.rd*ray.hit[0], ray.hit[1]);
   if(ray.hit[0] > FAR)
-    return bg;
+    return false;
 
   ray.mat = material(int(ray.hit[1]));
 
   ray.hitp = ray.ro + ray.rd*ray.hit[0];
   ray.hitn = normal(ray.hitp, ray.hit[2]);
+  return true;
+}
 
+// Colors a marched hit and sets the ray up for the next bounce. bg is the sky behind the hit, for the fog.
+vec3 shade(inout Ray ray, in vec3 bg) {
   vec3 texCol = getTexel(int(ray.hit[1]), ray.mat, ray.hitp);
 
   if(ray.mat.rough == 1.)
@@ -381,6 +933,13 @@ vec3 bounce(inout Ray ray) {
   return texCol;
 }
 
+vec3 bounce(inout Ray ray) {
+  vec3 bg = bgcol(ray.rd);
+  if(!march(ray))
+    return bg;
+  return shade(ray, bg);
+}
+
 void surfcol(inout vec3 pixelColor, in Ray ray) {
   for(ray.bounces; ray.hit[0] < FAR && ray.bounces < BOUNCES && ray.mat.rough < 1.; ray.bounces++)
     pixelColor += bounce(ray);
@@ -396,32 +955,245 @@ vec3 LookAt(vec2 uv){
     
   return normalize((uv.x*r - uv.y*up)*FOV + look);
 }
-vec3 PixelColor(vec2 uv) {
-  vec3 pixelColor;
-  
+// The primary ray of a pixel, jittered inside it while accumulating so the history converges to an antialiased image.
+Ray primaryRay(in vec2 fragCoord) {
+  if(temporal > 0.)
+    fragCoord += vec2(Hash11(seed), Hash11(seed + 0.5)) - 0.5;
+
   Ray ray;
   ray.ro = cam;
-  ray.rd = LookAt(uv);
-
+  ray.rd = LookAt((fragCoord - 0.5*res)/res.y);
+  ray.bounces = 0;
+  ray.hit = float[3](0., 0., 0.);
+  ray.mat = Material(vec4(0), 0., 0., 0.);
+  return ray;
+}
+vec3 PixelColor(in Ray ray) {
+  vec3 pixelColor = vec3(0);
   surfcol(pixelColor, ray);
-
   return pixelColor;
 }
 
 void mainImage(out vec3 pixelColor, in vec2 fragCoord) {
-  vec2 uv = (fragCoord - 0.5*res)/res.y;
+  pixelColor = PixelColor(primaryRay(fragCoord));
+}
 
-  // SPINNING LIGHTS
-  for(int i = 0; i < lights.length(); i++)
-    lights[i].pos.xz *= rotationMatrix(time*i*TAU*0.0004);
-  
-  pixelColor += PixelColor(uv);
+float temporalStart(in ivec2 pixel) {
+  // Anything the reprojection got wrong, like something moving in front of a reused hit, lasts at most TEMPORAL_REFRESH frames.
+  // Whole tiles refresh together so neighbouring pixels, which the GPU runs in lockstep, take the same path.
+  ivec2 tile = pixel/TEMPORAL_TILE;
+  if((tile.x + 2*tile.y + int(frame)) % TEMPORAL_REFRESH == 0)
+    return 0.;
+  return texelFetch(reprojected, pixel, 0).r;
+}
+// Where p is on screen for a camera at eye looking along dir. Inverse of LookAt(); false behind it or off screen.
+bool screenCoord(in vec3 p, in vec3 eye, in vec3 dir, out vec2 coord) {
+  vec3 v = p - eye;
+  vec3 r = normalize(cross(vec3(0, 1, 0), dir));
+  vec3 up = cross(r, dir);
+
+  float z = dot(v, dir);
+  coord = vec2(0);
+  if(z <= 0.)
+    return false;
+  coord = vec2(dot(v, r), -dot(v, up))/(z*FOV)*res.y + 0.5*res;
+  return all(greaterThanEqual(coord, vec2(0))) && all(lessThan(coord, res));
+}
+vec3 accumulate(in vec3 current) {
+  // Where this pixel's hit was on screen last frame.
+  vec2 prevCoord;
+  if(!screenCoord(primaryHit.xyz, prevCam, prevLook, prevCoord))
+    return current;
+
+  // Disoccluded, or the surface there moved: the history belongs to something else.
+  vec4 prevHit = texelFetch(historyHit, ivec2(prevCoord), 0);
+  if(prevHit.w != primaryHit.w || ANIMATED(prevHit.w) || distance(prevHit.xyz, primaryHit.xyz) > TEMPORAL_TOLERANCE*distance(primaryHit.xyz, prevCam))
+    return current;
+
+  return mix(texture(historyColor, prevCoord/res).rgb, current, TEMPORAL_BLEND);
+}
+
+// Marches one cone wide enough to hold every primary ray of a tile, including the temporal jitter, and stops where
+// it first touches the scene. Runs as its own pass with CONE_PREPASS defined, one fragment per tile.
+float coneMarch(in vec2 tileCoord) {
+  vec2 uv = (tileCoord*coneTile - 0.5*res)/res.y;
+  vec3 rd = LookAt(uv);
+
+  // Radius per unit of distance. FOV/res.y is the widest a pixel gets, at the center of the screen.
+  float spread = (coneTile*0.7072 + 1.)*FOV/res.y;
+
+  float dist = 0.;
+  for(int i = 0; i < CONE_STEPS && dist < FAR; i++) {
+    float d = sdf(cam + rd*dist)[0];
+    float radius = dist*spread;
+    if(d - radius < HIT)
+      break;
+    // Far enough that the next step stays inside this sphere for every ray of the cone.
+    dist += (d - radius)/(1. + spread);
+  }
+  return dist;
 }
 
+// Where the primary ray of a pixel can start, from the temporal cache and the cone prepass.
+void setPrimaryStart(in ivec2 pixel) {
+  if(temporal > 0.)
+    primaryStart = temporalStart(pixel);
+  if(coneTile > 0.)
+    primaryStart = max(primaryStart, texelFetch(coneDepth, pixel/int(coneTile), 0).r);
+}
+
+// The primary ray through center without jitter, marched from where the cone prepass says. For the passes that work
+// per block of pixels.
+bool marchBlock(in vec2 center, out Ray ray) {
+  if(coneTile > 0.)
+    primaryStart = texelFetch(coneDepth, ivec2(center)/int(coneTile), 0).r;
+
+  ray.ro = cam;
+  ray.rd = LookAt((center - 0.5*res)/res.y);
+  ray.bounces = 0;
+  ray.hit = float[3](0., 0., 0.);
+  ray.mat = Material(vec4(0), 0., 0., 0.);
+  return march(ray);
+}
+
+#ifdef CONE_PREPASS
+void main(){
+  col = vec3(coneMarch(gl_FragCoord.xy), 0, 0);
+}
+#elif defined(BRICK_BAKE)
+// -1 bakes one fragment per brick of the grid, laid out brickGrid.x wide and brickGrid.y*brickGrid.z high: sdfStatic()
+// and its material at the brick's center. Otherwise this atlas layer, every texel looking up its brick in brickSlots.
+uniform float brickLayer;
+uniform sampler3D brickSlots;
+
+void main(){
+  float brick = float(BRICK_SAMPLES-1)*brickVoxel;
+  vec3 at;
+  if(brickLayer < 0.) {
+    ivec2 cell = ivec2(gl_FragCoord.xy);
+    int rows = int(brickGrid.y);
+    at = brickOrigin + (vec3(cell.x, cell.y % rows, cell.y / rows) + 0.5)*brick;
+  }
+  else {
+    ivec3 texel = ivec3(ivec2(gl_FragCoord.xy), int(brickLayer));
+    vec3 slot = texelFetch(brickSlots, texel / BRICK_SAMPLES, 0).xyz;
+    at = brickOrigin + slot*brick + vec3(texel % BRICK_SAMPLES)*brickVoxel;
+  }
+
+  float[2] data = float[](FAR, 0);
+  sdfStatic(at, data);
+  col = vec3(data[0], data[1], 0);
+}
+#elif defined(AO_PASS)
+// AO CACHE (AmbientOcclusion.h), one fragment per aoScale x aoScale block: the primary hit through the block's center
+// and its occlusion, taken from last frame's block where the same static surface was there. Goes out through 'hit'.
 void main(){
-  vec3 pixelColor;
+  Ray ray;
+  if(!marchBlock(gl_FragCoord.xy*aoScale, ray)) {
+    hit = vec4(primaryHit.xyz, -1);
+    return;
+  }
 
+  float occ = -1.;
+  ivec2 tile = ivec2(gl_FragCoord.xy)/AO_TILE;
+  vec2 prevCoord;
+  if(aoValid > 0. && !ANIMATED(ray.hit[1]) && (tile.x + 2*tile.y + int(aoFrame)) % AO_REFRESH != 0
+     && screenCoord(ray.hitp, aoPrevCam, aoPrevLook, prevCoord)) {
+    vec4 prev = texelFetch(aoHistory, ivec2(prevCoord/aoScale), 0);
+    if(prev.w >= 0. && distance(prev.xyz, ray.hitp) < AO_TOLERANCE*ray.hit[0])
+      occ = prev.w;
+  }
+  if(occ < 0.)
+    occ = calculateAO(ray.hitp, ray.hitn);
+  hit = vec4(ray.hitp, occ);
+}
+#elif defined(SHADOW_PASS)
+// SHADOW CACHE (ShadowCache.h), one fragment per shadowTile x shadowTile tile: the visibility of the lights that light
+// the hit through the tile's center the most. Goes out through 'hit'.
+void main(){
+  Ray ray;
+  vec4 slots = vec4(-1);
+  if(marchBlock(gl_FragCoord.xy*shadowTile, ray)) {
+    ivec4 picked = pickShadowLights(ray.hitp, ray.hitn, SHADOW_LIGHTS);
+    for(int s = 0; s < SHADOW_LIGHTS; s++) {
+      int i = picked[s];
+      if(i < 0) continue;
+      vec3 lightVector = lights[i].pos - ray.hitp;
+      float lightDistance = length(lightVector);
+      slots[s] = float(i) + SHADOW_PACK*softShadow(ray.hitp + ray.hitn*SHADOW_BIAS, lightVector/lightDistance, lightDistance);
+    }
+  }
+  hit = slots;
+}
+#elif defined(GBUFFER_PASS)
+// DEFERRED (DeferredShading.h), first pass: only the primary march. col takes the normal, hit the hit as always, and
+// the depth tells the shading pass which pixels are sky.
+void main(){
+  setPrimaryStart(ivec2(gl_FragCoord.xy));
+
+  Ray ray = primaryRay(gl_FragCoord.xy);
+  bool surface = march(ray);
+
+  col = surface ? ray.hitn : vec3(0);
+  hit = primaryHit;
+  gl_FragDepth = surface ? 1. : 0.;
+}
+#elif defined(SHADE_PASS)
+// DEFERRED, surface pixels: everything after the primary march, starting from the G-buffer.
+uniform sampler2D gNormal;
+uniform sampler2D gHit;
+
+void main(){
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  primaryHit = texelFetch(gHit, pixel, 0);
+
+  Ray ray;
+  ray.ro = cam;
+  ray.rd = normalize(primaryHit.xyz - cam);
+  ray.bounces = 0;
+  ray.hitp = primaryHit.xyz;
+  ray.hitn = texelFetch(gNormal, pixel, 0).xyz;
+  ray.hit = float[3](distance(cam, ray.hitp), primaryHit.w, 0.);
+  ray.mat = material(int(primaryHit.w));
+
+  vec3 pixelColor = shade(ray, bgcol(ray.rd));
+  ray.bounces = 1;
+  surfcol(pixelColor, ray);
+
+  if(temporal > 0.)
+    pixelColor = accumulate(pixelColor);
+  col = pixelColor;
+  hit = primaryHit;
+}
+#elif defined(SKY_PASS)
+// DEFERRED, sky pixels: the background, in a program small enough not to hold the surfaces' registers.
+uniform sampler2D gHit;
+
+void main(){
+  primaryHit = texelFetch(gHit, ivec2(gl_FragCoord.xy), 0);
+  vec3 pixelColor = bgcol(normalize(primaryHit.xyz - cam));
+
+  if(temporal > 0.)
+    pixelColor = accumulate(pixelColor);
+  col = pixelColor;
+  hit = primaryHit;
+}
+#else
+void main(){
+  vec3 pixelColor = vec3(0);
+
+  setPrimaryStart(ivec2(gl_FragCoord.xy));
   mainImage(pixelColor, gl_FragCoord.xy);
 
+  if(temporal > 0.)
+    pixelColor = accumulate(pixelColor);
+
+#ifdef STEP_COUNT
+  // 16 bits over red and green, exact through an RGBA8 target.
+  col = vec3(mod(float(marchSteps), 256.), floor(float(marchSteps)/256.), 0)/255.;
+#else
   col = pixelColor;
-}
\ No newline at end of file
+#endif
+  hit = primaryHit;
+}
+#endif
\ No newline at end of file
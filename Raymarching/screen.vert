@@ -2,6 +2,6 @@
 layout(location = 0) in vec2 vertexPosition;
 
 void main() {
-	gl_Position.xy = vertexPosition;
-	gl_Position.w = 1.0;
+	// z 0 is window depth 0.5, which the deferred passes test the G-buffer depth against.
+	gl_Position = vec4(vertexPosition, 0.0, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "AmbientOcclusion.h"
+#include <glm/glm.hpp>
+#include <stdio.h>
+#include <string>
+
+AmbientOcclusion::AmbientOcclusion(UniformBinding& uniforms, int scale, const char* defines) : scale(scale < 1 ? 1 : scale) {
+	program = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define AO_PASS\n").c_str());
+	uniforms.attach(program);
+	attach(program, uniforms);
+
+	prevCamLoc = uniforms.location(program, "aoPrevCam");
+	prevLookLoc = uniforms.location(program, "aoPrevLook");
+	validLoc = uniforms.location(program, "aoValid");
+	frameLoc = uniforms.location(program, "aoFrame");
+
+	GLint previous = 0, loc;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(program);
+	if ((loc = uniforms.location(program, "aoHistory")) != -1)
+		glUniform1i(loc, AO_HISTORY_UNIT);
+	glUseProgram(previous);
+}
+AmbientOcclusion::~AmbientOcclusion() {
+	release();
+	glDeleteProgram(program);
+}
+
+void AmbientOcclusion::attach(GLuint target, const UniformBinding& uniforms) {
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(target);
+
+	GLint loc;
+	if ((loc = uniforms.location(target, "aoCache")) != -1)
+		glUniform1i(loc, AO_CACHE_UNIT);
+	if ((loc = uniforms.location(target, "aoScale")) != -1)
+		glUniform1f(loc, float(scale));
+
+	glUseProgram(previous);
+}
+
+void AmbientOcclusion::allocate(glm::ivec2 size) {
+	release();
+	this->size = size;
+
+	// The hit goes to the shader's second output, like the temporal cache's.
+	const GLenum buffers[] = { GL_NONE, GL_COLOR_ATTACHMENT0 };
+	for (int i = 0; i < 2; i++) {
+		glGenTextures(1, &cache[i]);
+		glBindTexture(GL_TEXTURE_2D, cache[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size.x, size.y, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glGenFramebuffers(1, &FBO[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cache[i], 0);
+		glDrawBuffers(2, buffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("AO cache framebuffer %dx%d is incomplete\n", size.x, size.y);
+	}
+	valid = false;
+}
+
+void AmbientOcclusion::release() {
+	if (FBO[0] == 0)
+		return;
+	glDeleteFramebuffers(2, FBO);
+	glDeleteTextures(2, cache);
+	FBO[0] = FBO[1] = 0;
+}
+
+void AmbientOcclusion::render(const FrameUniforms& u, GLuint vertexbuffer) {
+	GLint outer = 0, previous = 0, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glm::ivec2 frame = glm::max(glm::ivec2(u.res), glm::ivec2(1));
+	glm::ivec2 wanted = (frame + scale - 1) / scale;
+	if (wanted != size)
+		allocate(wanted);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO[current]);
+	glViewport(0, 0, size.x, size.y);
+	glUseProgram(program);
+	glUniform3f(prevCamLoc, cam.x, cam.y, cam.z);
+	glUniform3f(prevLookLoc, look.x, look.y, look.z);
+	glUniform1f(validLoc, valid ? 1.0f : 0.0f);
+	glUniform1f(frameLoc, float(this->frame % 1024));
+
+	glActiveTexture(GL_TEXTURE0 + AO_HISTORY_UNIT);
+	glBindTexture(GL_TEXTURE_2D, cache[1 - current]);
+	drawScreen(vertexbuffer);
+
+	glActiveTexture(GL_TEXTURE0 + AO_CACHE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, cache[current]);
+	glActiveTexture(GL_TEXTURE0);
+
+	cam = u.cam;
+	look = u.look;
+	valid = true;
+	current = 1 - current;
+	this->frame++;
+
+	glUseProgram(previous);
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
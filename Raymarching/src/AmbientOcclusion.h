@@ -0,0 +1,62 @@
+#pragma once
+#include "Raymarching.h"
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+/*
+AMBIENT OCCLUSION CACHE:
+  calculateAO() is AO_SAMPLES sdf() calls for every lit hit. For the primary hits it moves into its own pass: screen.frag
+  built with AO_PASS runs once per scale x scale block of the screen, marches the ray through the block's center and
+  writes that hit and its occlusion. The full resolution pass then reads the occlusion of its primary hit from the four
+  nearest blocks, weighted bilinearly and by whether each block's hit lies on the same surface (a bilateral upsample).
+  Only where none of them does, on silhouettes, does a pixel compute its own.
+
+  Blocks also carry their occlusion over from last frame: the AO pass looks up where its hit was in the previous view,
+  and if the same static surface was there takes that block's value instead of sampling again. A rotating quarter of
+  the blocks samples every frame regardless (AO_REFRESH in screen.frag), which bounds how long the ground stays wrong
+  under something moving over it. Animated surfaces always sample.
+
+  So AO_SAMPLES sets the quality, and the scale and the reuse set the cost, which is paid per block instead of per pixel.
+  Every block still marches its own ray, starting where the cone prepass says when there is one, so small scales spend
+  more on marching than they save on sampling. Occlusion of reflected and refracted hits is still computed where they're
+  shaded.
+*/
+
+#define AO_SCALE 4
+#define AO_CACHE_UNIT 10
+#define AO_HISTORY_UNIT 11
+
+class AmbientOcclusion {
+public:
+	// defines should be the ones the screen program was built with, so both march the same scene.
+	AmbientOcclusion(UniformBinding& uniforms, int scale = AO_SCALE, const char* defines = "");
+	~AmbientOcclusion();
+
+	// Points a program's aoCache sampler at the cache and tells it the block size.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	// Renders the cache for the frame with the Frame block already uploaded from u, then puts the framebuffer,
+	// viewport and program back the way they were.
+	void render(const FrameUniforms& u, GLuint vertexbuffer);
+
+	// The AO pass, which marches, for the cone prepass and the brick map to attach to.
+	GLuint shader() const { return program; }
+
+private:
+	void allocate(glm::ivec2 size);
+	void release();
+
+	GLuint program = 0;
+	GLint prevCamLoc = -1, prevLookLoc = -1, validLoc = -1, frameLoc = -1;
+
+	GLuint FBO[2] = { 0, 0 }, cache[2] = { 0, 0 };
+	int scale;
+	glm::ivec2 size = glm::ivec2(0);
+	int current = 0;
+	bool valid = false; // whether the other cache holds last frame's
+	long long frame = 0;
+
+	glm::vec3 cam = glm::vec3(0.0f), look = glm::vec3(0.0f, 0.0f, 1.0f);
+};
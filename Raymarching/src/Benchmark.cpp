@@ -0,0 +1,427 @@
+#include "Benchmark.h"
+#include "Raymarching.h"
+#include "Uniforms.h"
+#include "Clock.h"
+#include "ConePrepass.h"
+#include "BrickMap.h"
+#include "AmbientOcclusion.h"
+#include "ShadowCache.h"
+#include "DeferredShading.h"
+#include "LightBuffer.h"
+#include "SceneCompiler.h"
+#include "SceneInterpreter.h"
+#include "ShaderVariants.h"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#define PI 3.141592f
+
+static glm::vec3 upFor(glm::vec3 fwd) {
+	// Same basis input() builds.
+	return cross(fwd, normalize(cross(glm::vec3{ 0.0f, 1.0f, 0.0f }, fwd)));
+}
+static CameraKey lookAt(double time, glm::vec3 ro, glm::vec3 target) {
+	glm::vec3 fwd = normalize(target - ro);
+	return { time, ro, fwd, upFor(fwd) };
+}
+
+bool loadCameraPath(const char* path, CameraPath& out) {
+	std::ifstream in(path);
+	if (!in.is_open()) {
+		printf("Impossible to open %s.\n", path);
+		return false;
+	}
+
+	out.name = path;
+	out.keys.clear();
+
+	std::string line;
+	while (std::getline(in, line)) {
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.resize(comment);
+
+		std::istringstream fields(line);
+		CameraKey k;
+		if (!(fields >> k.time))
+			continue;
+		if (!(fields >> k.ro.x >> k.ro.y >> k.ro.z >> k.fwd.x >> k.fwd.y >> k.fwd.z >> k.up.x >> k.up.y >> k.up.z)) {
+			printf("%s: bad camera key '%s'\n", path, line.c_str());
+			return false;
+		}
+		out.keys.push_back(k);
+	}
+	return !out.keys.empty();
+}
+
+bool saveCameraPath(const char* path, const CameraPath& in) {
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		printf("Impossible to open %s for writing.\n", path);
+		return false;
+	}
+	fprintf(out, "# time_ms ro.x ro.y ro.z fwd.x fwd.y fwd.z up.x up.y up.z\n");
+	for (const CameraKey& k : in.keys)
+		fprintf(out, "%.4f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f\n", k.time, k.ro.x, k.ro.y, k.ro.z, k.fwd.x, k.fwd.y, k.fwd.z, k.up.x, k.up.y, k.up.z);
+	fclose(out);
+	return true;
+}
+
+std::vector<CameraPath> builtinCameraPaths(int frames) {
+	std::vector<CameraPath> paths(3);
+	paths[0].name = "orbit";   // circles the spinner at the origin, ground and sky in view
+	paths[1].name = "mirrors"; // rises under the mirrors and icosahedron, mostly reflective pixels
+	paths[2].name = "morph";   // closes in on the refractive morphing box
+
+	for (int i = 0; i < frames; i++) {
+		float f = frames > 1 ? float(i) / (frames - 1) : 0.0f;
+		double time = i * 16.0;
+
+		float a = f * 2.0f * PI;
+		paths[0].keys.push_back(lookAt(time, glm::vec3(8.0f * sin(a), 1.0f, -8.0f * cos(a)), glm::vec3(0.0f)));
+
+		paths[1].keys.push_back(lookAt(time, glm::vec3(2.0f * sin(a), 1.0f + 5.0f * f, -11.0f), glm::vec3(0.0f, 9.0f, 0.0f)));
+
+		paths[2].keys.push_back(lookAt(time, glm::vec3(10.0f + 2.0f * sin(a), -5.0f, -12.0f + 6.0f * f), glm::vec3(10.0f, -6.0f, 0.0f)));
+	}
+	return paths;
+}
+
+struct BenchResult {
+	std::string path;
+	int wid, hei, frames;
+	double fps, msMin, msP50, msP90, msP99, mpixPerSec;
+	double stepsMean = -1.0, stepsP50 = -1.0, stepsP99 = -1.0; // trace() steps per pixel, only with -steps
+	double stageMs[3] = { -1.0, -1.0, -1.0 }; // mean G-buffer, surface and sky pass, only with -deferred
+};
+
+static double percentile(const std::vector<double>& sorted, double p) {
+	size_t i = std::min(sorted.size() - 1, size_t(sorted.size() * p));
+	return sorted[i];
+}
+static double percentile(const std::vector<long long>& histogram, long long total, double p) {
+	long long wanted = std::min(total - 1, (long long)(total * p)), seen = 0;
+	for (size_t i = 0; i < histogram.size(); i++) {
+		seen += histogram[i];
+		if (seen > wanted)
+			return double(i);
+	}
+	return double(histogram.size() - 1);
+}
+
+int benchMain(int argc, char** argv) {
+	const char* out = "bench.json";
+	int frames = BENCH_FRAMES;
+	std::vector<glm::ivec2> resolutions;
+	std::vector<CameraPath> paths;
+	int coneTile = 0, aoScale = 0, shadowTile = -1, extraLights = 0;
+	float brickVoxel = 0.f;
+	const char* scenePath = NULL;
+	bool interpretScene = false;
+	bool countSteps = false, deferredShading = false;
+	double relaxation = 1.0;
+	int quality = QUALITY_DEFAULT;
+	std::string defines, defineArgs;
+
+	for (int i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			out = argv[++i];
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-cone") == 0)
+			coneTile = takeNumber(argc, argv, i) ? atoi(argv[i]) : CONE_TILE;
+		else if (strcmp(argv[i], "-ao") == 0)
+			aoScale = takeNumber(argc, argv, i) ? atoi(argv[i]) : AO_SCALE;
+		else if (strcmp(argv[i], "-shadows") == 0)
+			shadowTile = takeNumber(argc, argv, i) ? atoi(argv[i]) : SHADOW_TILE;
+		else if (strcmp(argv[i], "-bricks") == 0)
+			brickVoxel = takeNumber(argc, argv, i) ? float(atof(argv[i])) : BRICK_VOXEL;
+		else if (strcmp(argv[i], "-lights") == 0 && i + 1 < argc)
+			extraLights = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+			scenePath = argv[++i];
+		else if (strcmp(argv[i], "-interpret") == 0)
+			interpretScene = true;
+		else if (strcmp(argv[i], "-relax") == 0)
+			relaxation = takeNumber(argc, argv, i) ? atof(argv[i]) : 1.6;
+		else if (strcmp(argv[i], "-quality") == 0 && i + 1 < argc) {
+			quality = qualityTier(argv[++i]);
+			if (quality == -1) {
+				printf("Unknown quality tier %s, it's low, medium, high or ultra\n", argv[i]);
+				return -1;
+			}
+		}
+		else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+			defines += defineLine(argv[++i]);
+			defineArgs += (defineArgs.empty() ? "" : " ") + std::string(argv[i]);
+		}
+		else if (strcmp(argv[i], "-deferred") == 0)
+			deferredShading = true;
+		else if (strcmp(argv[i], "-steps") == 0)
+			countSteps = true;
+		else if (strcmp(argv[i], "-res") == 0 && i + 1 < argc) {
+			glm::ivec2 r;
+			if (sscanf(argv[++i], "%dx%d", &r.x, &r.y) == 2 && r.x > 0 && r.y > 0)
+				resolutions.push_back(r);
+		}
+		else {
+			CameraPath path;
+			if (!loadCameraPath(argv[i], path))
+				return -1;
+			paths.push_back(path);
+		}
+	}
+	if (resolutions.empty())
+		resolutions = { { 320, 180 }, { 640, 360 }, { 1280, 720 } };
+	if (paths.empty())
+		paths = builtinCameraPaths(frames);
+
+	// One framebuffer big enough for every resolution; smaller runs use the lower left corner.
+	glm::ivec2 largest(0);
+	for (glm::ivec2 r : resolutions)
+		largest = glm::max(largest, r);
+
+	if (relaxation != 1.0)
+		defines += "#define RELAXATION " + std::to_string(relaxation) + "\n";
+	if (brickVoxel > 0.f && scenePath == NULL)
+		defines += "#define BRICKS\n";
+	if (shadowTile >= 0)
+		defines += "#define SHADOWS 1\n";
+	// The interpreter takes the scene as it loads, the compiled one goes into the defines.
+	Scene source;
+	CompiledScene scene;
+	if (scenePath != NULL) {
+		if (interpretScene) {
+			if (!loadScene(scenePath, source))
+				return -1;
+			defines += SceneInterpreter::defines();
+			scene.lights = source.lights;
+		}
+		else if (!compileScene(scenePath, scene))
+			return -1;
+		else
+			defines += scene.defines;
+		if (brickVoxel > 0.f) {
+			printf("The brick map only bakes the built-in scene, ignoring -bricks\n");
+			brickVoxel = 0.f;
+		}
+	}
+
+	// Every program gets the tier, under whatever -D and the options above already set.
+	defines = variantDefines(defines, QUALITY[quality].defines);
+
+	unsigned int vertexbuffer, FBO, color, screen;
+	if (initHeadless(largest.x, largest.y, &vertexbuffer, &FBO, &color, &screen, defines.c_str()) == -1)
+		return -1;
+
+	UniformBinding* uniforms = new UniformBinding();
+	uniforms->attach(screen);
+
+	// Same shader writing its step count instead of a color. Drawn after each timed frame, outside the timing.
+	GLuint steps = 0;
+	if (countSteps) {
+		steps = LoadShaders("screen.vert", "screen.frag", (defines + "#define STEP_COUNT\n").c_str());
+		uniforms->attach(steps);
+	}
+	std::vector<unsigned char> stepPixels(countSteps ? size_t(largest.x) * largest.y * 4 : 0);
+
+	// Every program that runs screen.frag's main pass.
+	std::vector<GLuint> passes = { screen };
+	if (steps != 0)
+		passes.push_back(steps);
+	DeferredShading* deferred = NULL;
+	if (deferredShading) {
+		deferred = new DeferredShading(*uniforms, defines.c_str());
+		for (GLuint pass : deferred->shaders())
+			passes.push_back(pass);
+	}
+
+	ConePrepass* cone = NULL;
+	if (coneTile > 0) {
+		cone = new ConePrepass(*uniforms, coneTile, defines.c_str());
+		for (GLuint pass : passes)
+			cone->attach(pass, *uniforms);
+	}
+	AmbientOcclusion* ao = NULL;
+	if (aoScale > 0) {
+		ao = new AmbientOcclusion(*uniforms, aoScale, defines.c_str());
+		for (GLuint pass : passes)
+			ao->attach(pass, *uniforms);
+		if (cone)
+			cone->attach(ao->shader(), *uniforms);
+	}
+	ShadowCache* shadows = NULL;
+	if (shadowTile > 0) {
+		shadows = new ShadowCache(*uniforms, shadowTile, defines.c_str());
+		for (GLuint pass : passes)
+			shadows->attach(pass, *uniforms);
+		if (cone)
+			cone->attach(shadows->shader(), *uniforms);
+	}
+	BrickMap* bricks = NULL;
+	if (brickVoxel > 0.f) {
+		bricks = new BrickMap(*uniforms, vertexbuffer, brickVoxel, defines.c_str());
+		for (GLuint pass : passes)
+			bricks->attach(pass, *uniforms);
+		if (cone)
+			bricks->attach(cone->shader(), *uniforms);
+		if (ao)
+			bricks->attach(ao->shader(), *uniforms);
+		if (shadows)
+			bricks->attach(shadows->shader(), *uniforms);
+	}
+	LightBuffer* lights = new LightBuffer(extraLights, scenePath != NULL ? &scene.lights : NULL);
+	for (GLuint pass : passes)
+		lights->attach(pass, *uniforms);
+	if (shadows)
+		lights->attach(shadows->shader(), *uniforms);
+	SceneInterpreter* interpreter = NULL;
+	if (scenePath != NULL && interpretScene) {
+		interpreter = new SceneInterpreter(source, NULL);
+		if (!interpreter->valid())
+			return -1;
+		for (GLuint pass : passes)
+			interpreter->attach(pass, *uniforms);
+		if (cone)
+			interpreter->attach(cone->shader(), *uniforms);
+		if (ao)
+			interpreter->attach(ao->shader(), *uniforms);
+		if (shadows)
+			interpreter->attach(shadows->shader(), *uniforms);
+	}
+
+	std::vector<BenchResult> results;
+	for (const CameraPath& path : paths) {
+		for (glm::ivec2 r : resolutions) {
+			glViewport(0, 0, r.x, r.y);
+
+			int count = std::min(frames, int(path.keys.size()));
+			std::vector<double> ms;
+			double total = 0.0;
+			std::vector<long long> stepHistogram(countSteps ? 65536 : 0);
+			long long stepTotal = 0;
+			double stages[3] = { 0.0, 0.0, 0.0 };
+
+			for (int i = -BENCH_WARMUP; i < count; i++) {
+				const CameraKey& k = path.keys[i < 0 ? 0 : i];
+
+				long long start = nowNanos();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				FrameUniforms u = { glm::vec2(r), k.time, 0.0f, k.ro, k.fwd };
+				uniforms->upload(u);
+				lights->update(k.time);
+				if (interpreter)
+					interpreter->update(k.time);
+				if (cone)
+					cone->render(r, vertexbuffer);
+				if (ao)
+					ao->render(u, vertexbuffer);
+				if (shadows)
+					shadows->render(r, vertexbuffer);
+				double stage[3];
+				if (deferred)
+					deferred->render(r, vertexbuffer, stage);
+				else
+					drawScreen(vertexbuffer);
+				glFinish();
+				double elapsed = (nowNanos() - start) * 1e-6;
+
+				if (i >= 0) {
+					ms.push_back(elapsed);
+					total += elapsed;
+					for (int s = 0; deferred && s < 3; s++)
+						stages[s] += stage[s];
+				}
+
+				if (i >= 0 && steps != 0) {
+					glUseProgram(steps);
+					drawScreen(vertexbuffer);
+					glUseProgram(screen);
+
+					glReadPixels(0, 0, r.x, r.y, GL_RGBA, GL_UNSIGNED_BYTE, stepPixels.data());
+					for (int p = 0; p < r.x * r.y; p++) {
+						int n = stepPixels[p * 4] + 256 * stepPixels[p * 4 + 1];
+						stepHistogram[n]++;
+						stepTotal += n;
+					}
+				}
+			}
+			if (ms.empty())
+				continue;
+			std::sort(ms.begin(), ms.end());
+
+			BenchResult res;
+			res.path = path.name;
+			res.wid = r.x;
+			res.hei = r.y;
+			res.frames = int(ms.size());
+			res.fps = total > 0.0 ? ms.size() * 1000.0 / total : 0.0;
+			res.msMin = ms.front();
+			res.msP50 = percentile(ms, 0.5);
+			res.msP90 = percentile(ms, 0.9);
+			res.msP99 = percentile(ms, 0.99);
+			res.mpixPerSec = res.fps * r.x * r.y * 1e-6;
+			if (steps != 0) {
+				long long pixels = (long long)ms.size() * r.x * r.y;
+				res.stepsMean = double(stepTotal) / pixels;
+				res.stepsP50 = percentile(stepHistogram, pixels, 0.5);
+				res.stepsP99 = percentile(stepHistogram, pixels, 0.99);
+			}
+			for (int s = 0; deferred && s < 3; s++)
+				res.stageMs[s] = stages[s] / ms.size();
+			results.push_back(res);
+
+			printf("%-10s %5dx%-5d %8.2f fps  p50 %8.3f ms  p99 %8.3f ms  %8.2f Mpix/s", res.path.c_str(), res.wid, res.hei, res.fps, res.msP50, res.msP99, res.mpixPerSec);
+			if (steps != 0)
+				printf("  %7.1f steps/pixel (p99 %.0f)", res.stepsMean, res.stepsP99);
+			if (deferred)
+				printf("  gbuffer %.3f surfaces %.3f sky %.3f ms", res.stageMs[0], res.stageMs[1], res.stageMs[2]);
+			printf("\n");
+		}
+	}
+
+	FILE* f = fopen(out, "w");
+	if (f == NULL) {
+		printf("Impossible to open %s for writing.\n", out);
+	}
+	else {
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		const char* version = (const char*)glGetString(GL_VERSION);
+		fprintf(f, "{\n  \"renderer\": \"%s\",\n  \"version\": \"%s\",\n  \"build\": \"%s %s\",\n  \"cone_tile\": %d,\n  \"ao_scale\": %d,\n  \"shadow_tile\": %d,\n  \"brick_voxel\": %.3f,\n  \"bricks\": %d,\n  \"lights\": %d,\n  \"scene\": \"%s\",\n  \"scene_code\": %d,\n  \"relaxation\": %.3f,\n  \"quality\": \"%s\",\n  \"defines\": \"%s\",\n  \"results\": [\n",
+			jsonEscape(renderer ? renderer : "").c_str(), jsonEscape(version ? version : "").c_str(), __DATE__, __TIME__, coneTile, aoScale, shadowTile, brickVoxel, bricks ? bricks->bricks() : 0, lights->count(), jsonEscape(scenePath ? scenePath : "").c_str(), interpreter ? interpreter->instructions() : -1, relaxation, QUALITY[quality].name, jsonEscape(defineArgs).c_str());
+		for (size_t i = 0; i < results.size(); i++) {
+			const BenchResult& r = results[i];
+			fprintf(f, "    { \"path\": \"%s\", \"width\": %d, \"height\": %d, \"frames\": %d, \"fps\": %.3f, \"ms_min\": %.4f, \"ms_p50\": %.4f, \"ms_p90\": %.4f, \"ms_p99\": %.4f, \"mpix_per_s\": %.3f",
+				jsonEscape(r.path).c_str(), r.wid, r.hei, r.frames, r.fps, r.msMin, r.msP50, r.msP90, r.msP99, r.mpixPerSec);
+			if (r.stepsMean >= 0.0)
+				fprintf(f, ", \"steps_mean\": %.2f, \"steps_p50\": %.0f, \"steps_p99\": %.0f", r.stepsMean, r.stepsP50, r.stepsP99);
+			if (r.stageMs[0] >= 0.0)
+				fprintf(f, ", \"gbuffer_ms\": %.4f, \"surfaces_ms\": %.4f, \"sky_ms\": %.4f", r.stageMs[0], r.stageMs[1], r.stageMs[2]);
+			fprintf(f, " }%s\n", i + 1 < results.size() ? "," : "");
+		}
+		fprintf(f, "  ]\n}\n");
+		fclose(f);
+		printf("Wrote %s\n", out);
+	}
+
+	delete interpreter;
+	delete lights;
+	delete bricks;
+	delete shadows;
+	delete ao;
+	delete cone;
+	delete deferred;
+	if (steps != 0)
+		glDeleteProgram(steps);
+	delete uniforms;
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteTextures(1, &color);
+	glfwTerminate();
+	return 0;
+}
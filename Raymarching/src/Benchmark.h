@@ -0,0 +1,43 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <string>
+#include <vector>
+
+/*
+BENCHMARK:
+  Replays fixed camera paths through screen.frag headless at several resolutions and reports frames/sec, ms/frame
+  percentiles and megapixels/sec. Every frame is finished with glFinish before the next starts, so the numbers are
+  whole-frame latencies rather than pipelined throughput.
+
+  A camera path file is plain text, one frame per line, '#' starts a comment:
+    time_ms ro.x ro.y ro.z fwd.x fwd.y fwd.z up.x up.y up.z
+  up is read and written but not used: LookAt() in screen.frag builds up from world Y and fwd, as input() does, so
+  the camera can't roll and a path with roll in it renders as if it had none.
+
+  The builtin paths are three views of screen.frag's one built-in scene. For another scene, run them over a scene file
+  with -scene, e.g. -scene example.scene.
+*/
+
+#define BENCH_FRAMES 120
+#define BENCH_WARMUP 5
+
+struct CameraKey {
+	double time; // ms
+	glm::vec3 ro, fwd, up;
+};
+struct CameraPath {
+	std::string name;
+	std::vector<CameraKey> keys;
+};
+
+bool loadCameraPath(const char* path, CameraPath& out);
+bool saveCameraPath(const char* path, const CameraPath& in);
+// "orbit", "mirrors" and "morph"; each looks at a different part of the built-in scene.
+std::vector<CameraPath> builtinCameraPaths(int frames = BENCH_FRAMES);
+
+// -bench [-o results.json] [-frames N] [-res WxH]... [-cone [tile]] [-ao [scale]] [-shadows [tile]] [-bricks [voxel]] [-deferred] [-lights N] [-scene file [-interpret]] [-relax [omega]] [-quality tier] [-D NAME[=VALUE]]... [-steps] [path files...]
+// Without -res it runs 320x180, 640x360 and 1280x720; without path files it runs the builtin paths. -deferred also times
+// each of its passes, finishing after every one. -interpret runs the scene file on the bytecode interpreter, and the
+// JSON's scene_code is its length in instructions, -1 when the scene is compiled. -quality builds every
+// program at one of the tiers in ShaderVariants.h.
+int benchMain(int argc, char** argv);
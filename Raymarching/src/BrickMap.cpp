@@ -0,0 +1,172 @@
+#include "BrickMap.h"
+#include "Raymarching.h"
+#include "Clock.h"
+#include <glm/glm.hpp>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static GLuint genVolume(GLenum format, GLenum filter, glm::ivec3 size, GLenum type, const void* data) {
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_3D, tex);
+	glTexImage3D(GL_TEXTURE_3D, 0, format, size.x, size.y, size.z, 0, format == GL_RGB32F ? GL_RGB : format == GL_R16F ? GL_RED : GL_RGBA, type, data);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+BrickMap::BrickMap(UniformBinding& uniforms, GLuint vertexbuffer, float voxel, const char* defines) : voxel(voxel > 0.f ? voxel : BRICK_VOXEL) {
+	double start = nowMillis();
+
+	GLint outer = 0, previous = 0, viewport[4], maxSize = 0, maxVolume = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxVolume);
+
+	float brick = (BRICK_SAMPLES - 1) * this->voxel;
+	grid = glm::ivec3(glm::ceil((BRICK_MAX - BRICK_MIN) / brick));
+	if (grid.y * grid.z > maxSize || glm::max(grid.x, glm::max(grid.y, grid.z)) > maxVolume) {
+		printf("Brick map: a %dx%dx%d grid is too big for this GL, use a bigger voxel\n", grid.x, grid.y, grid.z);
+		grid = glm::ivec3(1);
+	}
+	int count = grid.x * grid.y * grid.z;
+
+	GLuint program = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define BRICK_BAKE\n").c_str());
+	uniforms.attach(program);
+	glUseProgram(program);
+	setGrid(program, uniforms);
+	GLint layer = uniforms.location(program, "brickLayer"), slotSampler = uniforms.location(program, "brickSlots");
+
+	// CLASSIFY: the distance at every brick's center, grid.x wide and one row per y and z.
+	GLuint centers, FBO;
+	glGenTextures(1, &centers);
+	glBindTexture(GL_TEXTURE_2D, centers);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, grid.x, grid.y * grid.z, 0, GL_RG, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, centers, 0);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Brick map classify framebuffer %dx%d is incomplete\n", grid.x, grid.y * grid.z);
+
+	glViewport(0, 0, grid.x, grid.y * grid.z);
+	glUniform1f(layer, -1.f);
+	drawScreen(vertexbuffer);
+
+	std::vector<glm::vec2> center(count);
+	glReadPixels(0, 0, grid.x, grid.y * grid.z, GL_RG, GL_FLOAT, center.data());
+	glDeleteTextures(1, &centers);
+
+	// ALLOCATE: a slot for every brick a surface might pass through, that is every brick whose center is nearer one than
+	// its half diagonal and the band. The rest keep the center's distance, as do the ones past what one atlas holds: they
+	// march as a surface at the brick's edge, but nothing points outside the atlas. Row order of the readback is the
+	// texel order of the index volume, x fastest.
+	float halfDiagonal = 0.866f * brick, band = halfDiagonal + BRICK_BAND * this->voxel;
+	int capacity = BRICK_SLOTS * BRICK_SLOTS * glm::max(maxVolume / BRICK_SAMPLES, 1);
+	std::vector<glm::vec4> entries(count);
+	std::vector<glm::vec3> slots;
+	int border = 0, dropped = 0;
+	for (int i = 0; i < count; i++) {
+		float d = center[i].x, mat = center[i].y;
+		if (glm::abs(d) >= band || int(slots.size()) == capacity) {
+			if (glm::abs(d) < band)
+				dropped++;
+			entries[i] = glm::vec4(-1.f, d, mat, 0.f);
+			continue;
+		}
+
+		int s = int(slots.size());
+		entries[i] = glm::vec4(s % BRICK_SLOTS, (s / BRICK_SLOTS) % BRICK_SLOTS, s / (BRICK_SLOTS * BRICK_SLOTS), mat);
+
+		glm::ivec3 cell(i % grid.x, (i / grid.x) % grid.y, i / (grid.x * grid.y));
+		slots.push_back(glm::vec3(cell));
+		if (glm::any(glm::equal(cell, glm::ivec3(0))) || glm::any(glm::equal(cell, grid - 1)))
+			border++;
+	}
+	allocated = int(slots.size());
+	if (border > 0)
+		printf("Brick map: %d bricks on the border of the grid hold a surface, widen BRICK_MIN..BRICK_MAX\n", border);
+	if (dropped > 0)
+		printf("Brick map: %d of %d bricks don't fit in one atlas and keep their center's distance, use a bigger voxel\n", dropped, allocated + dropped);
+
+	glm::ivec3 atlasSlots(glm::min(glm::max(allocated, 1), BRICK_SLOTS), 1, 1);
+	atlasSlots.y = glm::min((glm::max(allocated, 1) + atlasSlots.x - 1) / atlasSlots.x, BRICK_SLOTS);
+	atlasSlots.z = (glm::max(allocated, 1) + atlasSlots.x * atlasSlots.y - 1) / (atlasSlots.x * atlasSlots.y);
+	slots.resize(size_t(atlasSlots.x) * atlasSlots.y * atlasSlots.z);
+
+	index = genVolume(GL_RGBA32F, GL_NEAREST, grid, GL_FLOAT, entries.data());
+	GLuint slotTable = genVolume(GL_RGB32F, GL_NEAREST, atlasSlots, GL_FLOAT, slots.data());
+	glm::ivec3 atlasSize = atlasSlots * BRICK_SAMPLES;
+	atlas = genVolume(GL_R16F, GL_LINEAR, atlasSize, GL_FLOAT, NULL);
+
+	// FILL: every atlas layer in turn, each texel sampling sdfStatic() where its slot's brick puts it.
+	glActiveTexture(GL_TEXTURE0 + BRICK_ATLAS_UNIT);
+	glBindTexture(GL_TEXTURE_3D, slotTable);
+	glUniform1i(slotSampler, BRICK_ATLAS_UNIT);
+
+	glViewport(0, 0, atlasSize.x, atlasSize.y);
+	for (int z = 0; z < atlasSize.z; z++) {
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas, 0, z);
+		if (z == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Brick map atlas framebuffer %dx%d is incomplete\n", atlasSize.x, atlasSize.y);
+		glUniform1f(layer, float(z));
+		drawScreen(vertexbuffer);
+	}
+
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteTextures(1, &slotTable);
+	glDeleteProgram(program);
+
+	glActiveTexture(GL_TEXTURE0 + BRICK_INDEX_UNIT);
+	glBindTexture(GL_TEXTURE_3D, index);
+	glActiveTexture(GL_TEXTURE0 + BRICK_ATLAS_UNIT);
+	glBindTexture(GL_TEXTURE_3D, atlas);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUseProgram(previous);
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glFinish();
+	printf("Baked %d of %d bricks (%.2f voxel, %.1f MB atlas) in %.1f ms\n", allocated, count, this->voxel,
+		double(atlasSize.x) * atlasSize.y * atlasSize.z * 2 / (1024 * 1024), nowMillis() - start);
+}
+BrickMap::~BrickMap() {
+	glDeleteTextures(1, &index);
+	glDeleteTextures(1, &atlas);
+}
+
+void BrickMap::attach(GLuint target, const UniformBinding& uniforms) {
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(target);
+
+	GLint loc;
+	if ((loc = uniforms.location(target, "brickIndex")) != -1)
+		glUniform1i(loc, BRICK_INDEX_UNIT);
+	if ((loc = uniforms.location(target, "brickAtlas")) != -1)
+		glUniform1i(loc, BRICK_ATLAS_UNIT);
+	setGrid(target, uniforms);
+
+	glUseProgram(previous);
+}
+
+void BrickMap::setGrid(GLuint target, const UniformBinding& uniforms) {
+	GLint loc;
+	if ((loc = uniforms.location(target, "brickOrigin")) != -1)
+		glUniform3f(loc, BRICK_MIN.x, BRICK_MIN.y, BRICK_MIN.z);
+	if ((loc = uniforms.location(target, "brickGrid")) != -1)
+		glUniform3f(loc, float(grid.x), float(grid.y), float(grid.z));
+	if ((loc = uniforms.location(target, "brickVoxel")) != -1)
+		glUniform1f(loc, voxel);
+}
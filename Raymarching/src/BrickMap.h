@@ -0,0 +1,52 @@
+#pragma once
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+
+/*
+BRICK MAP:
+  Bakes sdfStatic() of screen.frag, the mirrors and the icosahedron, into a sparse distance field at startup, and
+  screen.frag built with BRICKS samples it instead of evaluating them. The grid over BRICK_MIN..BRICK_MAX is split into
+  bricks of BRICK_SAMPLES^3 samples. Only bricks a surface can pass through get a slot in the atlas; the rest store the
+  distance at their center, which less the way to the center bounds the distance anywhere inside them. Marching
+  through empty space costs one texel fetch whatever the scene holds.
+
+  Both passes run screen.frag built with BRICK_BAKE: one fragment per brick to find the ones near a surface, read back
+  to allocate the atlas, then one layer of the atlas at a time.
+
+  A baked object can't move, so with BRICKS the mirrors and the icosahedron hold still at STATIC_TIME. The spinner,
+  the morphing box and the ground stay analytic.
+
+  A filtered 3D fetch is one instruction to a GPU's texture units but dozens of them to a software rasterizer, so
+  there the baked mirrors cost more per step than the analytic ones.
+*/
+
+// Holds every mirror's bounding sphere (3.5 around (+-5, 9, +-5)) with room to spare, so the border bricks stay empty.
+#define BRICK_MIN glm::vec3(-9.f, 5.f, -9.f)
+#define BRICK_MAX glm::vec3(9.f, 13.f, 9.f)
+#define BRICK_VOXEL 0.03f
+#define BRICK_SAMPLES 8 // screen.frag has the same
+#define BRICK_BAND 2.f // voxels of band around every surface beyond the brick's own half diagonal
+#define BRICK_SLOTS 64 // atlas slots along x and y
+#define BRICK_INDEX_UNIT 5
+#define BRICK_ATLAS_UNIT 6
+
+class BrickMap {
+public:
+	// Bakes right away. defines should be the ones the screen program was built with.
+	BrickMap(UniformBinding& uniforms, GLuint vertexbuffer, float voxel = BRICK_VOXEL, const char* defines = "");
+	~BrickMap();
+
+	// Points a program's brick samplers at the map and tells it the grid.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	int bricks() const { return allocated; }
+
+private:
+	void setGrid(GLuint target, const UniformBinding& uniforms);
+
+	GLuint index = 0, atlas = 0;
+	float voxel;
+	glm::ivec3 grid;
+	int allocated = 0;
+};
@@ -0,0 +1,40 @@
+#include "Clock.h"
+#include <chrono>
+
+static long long steadyNanos() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SteadyClock::SteadyClock() : start(steadyNanos()) {}
+long long SteadyClock::nanos() {
+	return steadyNanos() - start;
+}
+
+// Built on first use rather than during static initialization, so globals elsewhere (Raymarching.cpp's epoch) can read
+// the time from their own initializers whatever order the objects are linked in. active is constant initialized.
+static SteadyClock& steady() {
+	static SteadyClock clock;
+	return clock;
+}
+static Clock* active = nullptr;
+
+static Clock& current() {
+	return active != nullptr ? *active : steady();
+}
+
+void setClock(Clock* clock) {
+	active = clock;
+}
+void tickClock() {
+	current().tick();
+}
+
+long long nowNanos() {
+	return current().nanos();
+}
+double nowMillis() {
+	return nowNanos() * 1e-6;
+}
+double nowSeconds() {
+	return nowNanos() * 1e-9;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+TIMING:
+  Everything that needs the time goes through the active Clock. The default is a steady (monotonic) nanosecond clock
+  that starts at zero, so nothing jumps when the wall clock is adjusted.
+
+  Replays and benchmarks swap in a FixedStepClock with setClock(); tickClock() is called once per frame and advances it
+  by exactly one step no matter how long the frame really took.
+*/
+
+class Clock {
+public:
+	virtual ~Clock() {}
+	virtual long long nanos() = 0;
+	virtual void tick() {}
+};
+
+class SteadyClock : public Clock {
+public:
+	SteadyClock();
+	long long nanos() override;
+private:
+	long long start;
+};
+
+class FixedStepClock : public Clock {
+public:
+	FixedStepClock(long long stepNanos, long long startNanos = 0) : step(stepNanos), now(startNanos) {}
+	long long nanos() override { return now; }
+	void tick() override { now += step; }
+	// Replays use this to step by each recorded frame's dT.
+	void setStep(long long stepNanos) { step = stepNanos; }
+private:
+	long long step, now;
+};
+
+// The clock is not owned; pass NULL to go back to the steady clock.
+void setClock(Clock* clock);
+void tickClock();
+
+long long nowNanos();
+double nowMillis();
+double nowSeconds();
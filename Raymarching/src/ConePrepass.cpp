@@ -0,0 +1,75 @@
+#include "ConePrepass.h"
+#include "Raymarching.h"
+#include <stdio.h>
+#include <string>
+
+ConePrepass::ConePrepass(UniformBinding& uniforms, int tile, const char* defines) : tile(tile < 1 ? 1 : tile) {
+	program = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define CONE_PREPASS\n").c_str());
+	uniforms.attach(program);
+	attach(program, uniforms);
+}
+ConePrepass::~ConePrepass() {
+	if (FBO != 0) {
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteTextures(1, &depth);
+	}
+	glDeleteProgram(program);
+}
+
+void ConePrepass::attach(GLuint target, const UniformBinding& uniforms) {
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(target);
+
+	GLint loc;
+	if ((loc = uniforms.location(target, "coneDepth")) != -1)
+		glUniform1i(loc, CONE_UNIT);
+	if ((loc = uniforms.location(target, "coneTile")) != -1)
+		glUniform1f(loc, float(tile));
+
+	glUseProgram(previous);
+}
+
+void ConePrepass::render(glm::ivec2 frame, GLuint vertexbuffer) {
+	GLint outer = 0, previous = 0, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glm::ivec2 wanted = (frame + tile - 1) / tile;
+	if (wanted != size) {
+		if (FBO != 0) {
+			glDeleteFramebuffers(1, &FBO);
+			glDeleteTextures(1, &depth);
+		}
+		size = wanted;
+
+		glGenTextures(1, &depth);
+		glBindTexture(GL_TEXTURE_2D, depth);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size.x, size.y, 0, GL_RED, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, depth, 0);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Cone prepass framebuffer %dx%d is incomplete\n", size.x, size.y);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, size.x, size.y);
+	glUseProgram(program);
+	drawScreen(vertexbuffer);
+
+	glActiveTexture(GL_TEXTURE0 + CONE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depth);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUseProgram(previous);
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+
+/*
+CONE PREPASS:
+  screen.frag built with CONE_PREPASS runs once per tile x tile block of the screen and cone-marches a cone wide enough
+  for every primary ray of the block. Where the cone first comes within HIT of the scene is a distance no ray of the block
+  can hit anything before, so the full resolution pass starts its primary rays there instead of at the camera.
+
+  Open space, the sky above all, collapses to a handful of steps per pixel. Tiles on silhouettes stop early and
+  gain little, which is why the tile stays small.
+*/
+
+#define CONE_TILE 8
+#define CONE_UNIT 4
+
+class ConePrepass {
+public:
+	// defines should be the ones the screen program was built with, so both march the same scene.
+	ConePrepass(UniformBinding& uniforms, int tile = CONE_TILE, const char* defines = "");
+	~ConePrepass();
+
+	// Points a program's coneDepth sampler at the prepass and tells it the tile size.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	// Renders the tile distances for a wid x hei frame with the Frame block already uploaded, then puts the
+	// framebuffer, viewport and program back the way they were.
+	void render(glm::ivec2 frame, GLuint vertexbuffer);
+
+	GLuint shader() const { return program; }
+
+private:
+	GLuint program = 0, FBO = 0, depth = 0;
+	int tile;
+	glm::ivec2 size = glm::ivec2(0);
+};
@@ -0,0 +1,589 @@
+#include "CpuRenderer.h"
+#include <glm/glm.hpp>
+#include <atomic>
+#include <thread>
+
+// Mirrors the #defines at the top of screen.frag. Keep the two in sync.
+#define FOV 1.1f
+
+#define STEPS 300
+
+#define FAR 250.f
+#define NEAR 0.2414f
+#define HIT 0.01f
+
+#define RELAXATION 1.f
+
+#define AMBIENT_PERCENT glm::vec3(0.005f)
+
+#define AMBIENT 1.f
+#define DIFFUSE 1.f
+#define SPECULAR 1.f
+#define EMISSIVE 1.f
+
+#define SPECULAR_FALLOFF 40.f
+
+#define BOUNCES 10
+
+#define AO 1
+#define AO_SAMPLES 10.f
+
+#define BOUNDS 1
+#define BOUND_MARGIN 1.f
+
+#define NORMAL_DELTA 0.01f
+
+#define PI 3.141592f
+#define TAU 6.283184f
+
+#define sat(a) glm::clamp(a, 0.f, 1.f)
+
+using glm::vec2;
+using glm::vec3;
+using glm::vec4;
+using glm::mat2;
+
+namespace {
+
+struct Material {
+	vec4 albedo;
+	float rough;
+	float metal;
+	float iref;
+};
+const Material materials[] = {
+	{ vec4(0.7f, 0.7f, 0.7f, 0.f), 1.f, 3.f, 0.f },
+	{ vec4(0.6f, 0.01f, 0.01f, 0.f), 1.f, 0.01f, 0.f },
+	{ vec4(1.f, 1.f, 1.f, 0.02f), 1.f, 1.f, 0.f }, // Spinny thing
+	{ vec4(0.f), 0.f, 0.01f, 0.f },
+	{ vec4(0.f), 0.f, 1.f, 0.f },
+	{ vec4(0.f), 0.8f, 1.f, 1.6f }
+};
+const int MATERIAL_COUNT = sizeof(materials) / sizeof(materials[0]);
+
+Material material(int index) {
+	if (index < 1 || index > MATERIAL_COUNT)
+		return Material{ vec4(0.f), 0.f, 0.f, 0.f };
+	return materials[index - 1];
+}
+
+struct PointLight {
+	vec3 pos;
+	vec4 col;
+	float radius;
+};
+const int LIGHT_COUNT = 3;
+
+struct Ray {
+	vec3 ro, rd;
+
+	int bounces = 0;
+	vec3 hit = vec3(0.f); // 0: distance along ray  1: materialID  2: last sdf distance
+	vec3 hitp = vec3(0.f), hitn = vec3(0.f);
+	Material mat = { vec4(0.f), 0.f, 0.f, 0.f };
+};
+
+// Per frame state shared read-only by every worker.
+struct Scene {
+	FrameUniforms u;
+	float time;
+	int normals;
+	PointLight lights[LIGHT_COUNT];
+};
+
+mat2 rotationMatrix(float angle) {
+	float s = glm::sin(angle), c = glm::cos(angle);
+	return mat2(c, -s, s, c);
+}
+
+vec3 bgcol(const Scene& s, vec3 rd) {
+	vec3 skyc = vec3(0.15f, 0.51f, 0.91f);
+	vec3 horizon = vec3(0.63f, 0.78f, 0.91f);
+	vec3 ground = vec3(0.27f, 0.34f, 0.40f);
+	ground = glm::mix(ground, vec3(0.07f, 0.14f, 0.20f), glm::smoothstep(0.1f, 1.f, -rd.y));
+
+	vec3 sky = glm::mix(horizon, skyc, glm::smoothstep(0.05f, 0.7f, rd.y + sat(glm::sin(rd.y * rd.x * rd.z + s.time * 0.001f))));
+
+	vec3 bg = glm::mix(ground, sky, glm::smoothstep(0.f, 0.02f, rd.y));
+	bg *= glm::mix(vec3(1.f), 1.4f * horizon, glm::smoothstep(0.1f, 0.f, glm::abs(rd.y)));
+
+	vec3 sunp = normalize(vec3(0.4f, 0.5f, -1.f));
+
+	bg += glm::mix(vec3(0.f), 2.f * horizon, glm::smoothstep(0.995f, 1.f, dot(rd, sunp)));
+
+	return bg;
+}
+
+float sdfSphere(vec3 pos, float r) { return length(pos) - r; }
+float sdfBox(vec3 p, vec3 s) {
+	p = glm::abs(p) - s;
+	return length(glm::max(p, 0.f)) + glm::min(glm::max(p.x, glm::max(p.y, p.z)), 0.f);
+}
+float sdfTorus(vec3 p, float r1, float r2) { return length(vec2(length(vec2(p.x, p.y)) - r1, p.z)) - r2; }
+float sdfRhombicIcos(vec3 p, float r) {
+	float c = glm::cos(PI / 5.f), s = glm::sqrt(0.75f - c * c);
+	vec3 n = vec3(-0.5f, -c, s);
+
+	p = glm::abs(p);
+	p -= 2.f * glm::min(0.f, dot(p, n)) * n;
+
+	p.x = glm::abs(p.x); p.y = glm::abs(p.y);
+	p -= 2.f * glm::min(0.f, dot(p, n)) * n;
+
+	p.x = glm::abs(p.x); p.y = glm::abs(p.y);
+	p -= 2.f * glm::min(0.f, dot(p, n)) * n;
+
+	return p.z - r;
+}
+
+// GLSL swizzle assignment helpers: v.xy *= m, v.xz *= m, v.zy *= m.
+void rotXY(vec3& v, const mat2& m) { vec2 r = vec2(v.x, v.y) * m; v.x = r.x; v.y = r.y; }
+void rotXZ(vec3& v, const mat2& m) { vec2 r = vec2(v.x, v.z) * m; v.x = r.x; v.z = r.y; }
+void rotZY(vec3& v, const mat2& m) { vec2 r = vec2(v.z, v.y) * m; v.z = r.x; v.y = r.y; }
+
+// See inBound() in screen.frag.
+bool inBound(vec2& data, float bound, float mat) {
+	if (BOUNDS == 0)
+		return true;
+	if (bound >= data[0])
+		return false;
+	if (bound > BOUND_MARGIN) {
+		data = vec2(bound, mat);
+		return false;
+	}
+	return true;
+}
+
+vec2 sdf(const Scene& s, vec3 p) {
+	vec2 data = vec2(FAR, 0.f);
+	float time = s.time;
+
+	// SCENE BUILD
+
+	// GROUND
+	float ground = glm::abs(p.y + 10.f) - 0.015f;
+	if (ground < data[0]) {
+		data[0] = ground;
+		data[1] = 1.f;
+	}
+
+	if (inBound(data, sdfSphere(p - vec3(0.f, 6.f, 0.f), 11.2f), 4.f)) {
+		// SPINNER
+		if (inBound(data, sdfSphere(p, 2.2f), 3.f)) {
+			// BALL
+			vec3 spinnerPos = p;
+			spinnerPos.y += 0.1f * glm::sin(time * TAU * 0.0004f);
+			float ball = sdfSphere(spinnerPos, 1.f);
+			if (ball < data[0]) {
+				data[0] = ball;
+				data[1] = 2.f;
+			}
+			// RINGS
+			rotXY(spinnerPos, rotationMatrix(time * 0.0014286f));
+			rotZY(spinnerPos, rotationMatrix(time * 0.0025f));
+			float ring = sdfTorus(spinnerPos, 1.5f, 0.1f);
+			if (ring < data[0]) {
+				data[0] = ring;
+				data[1] = 3.f;
+			}
+			rotXY(spinnerPos, rotationMatrix(-6.f * glm::sin(time * 0.0005263f)));
+			rotZY(spinnerPos, rotationMatrix(time * 0.001f));
+			ring = sdfTorus(spinnerPos, 2.f, 0.1f);
+			if (ring < data[0]) {
+				data[0] = ring;
+				data[1] = 3.f;
+			}
+		}
+
+		// MIRRORS
+		vec3 mirpos = p - vec3(0.f, 9.f, 0.f);
+
+		mirpos.x = glm::abs(mirpos.x) - 5.f;
+		mirpos.z = glm::abs(mirpos.z) - 5.f;
+
+		if (inBound(data, sdfSphere(mirpos, 3.5f), 4.f)) {
+			rotXZ(mirpos, rotationMatrix(PI / 4.f));
+			rotZY(mirpos, rotationMatrix(-PI / 6.f));
+
+			mirpos.y += 0.5f * glm::sin(mirpos.x * mirpos.z + time * 0.003f);
+
+			float mir = sdfBox(mirpos, vec3(1.8f + 0.1f * glm::sin(TAU * mirpos.y * mirpos.z + time * 0.005f), 2.f, 0.3f)) - 0.2f;
+			if (mir < data[0]) {
+				data[0] = mir * 0.5f;
+				data[1] = 4.f;
+			}
+		}
+
+		// RHOMBIC ICOSAHEDRON
+		vec3 icosp = p - vec3(0.f, 10.f, 0.f);
+		if (inBound(data, sdfSphere(icosp, 1.2f), 6.f)) {
+			rotXZ(icosp, rotationMatrix(time * 0.001f));
+			float icos = sdfRhombicIcos(icosp, 1.f);
+			if (icos < data[0]) {
+				data[0] = icos;
+				data[1] = 6.f;
+			}
+		}
+	}
+
+	// MORPHING BOX
+	vec3 mpos = p - vec3(10.f, -6.f, 0.f);
+	if (inBound(data, sdfSphere(mpos, 3.4f), 6.f)) {
+		float box = sdfBox(mpos, vec3(1.8f)) - 0.2f;
+		float sphere = sdfSphere(mpos, 2.f);
+
+		float morph = glm::mix(box, sphere, glm::smoothstep(-.2f, 1.f, glm::sin(time * 0.002f)));
+		if (morph < data[0]) {
+			data[0] = morph * 0.9f;
+			data[1] = 6.f;
+		}
+	}
+	// END SCENE
+
+	return vec2(glm::max(data[0], (NEAR - length(p - s.u.cam) * 0.9f)), data[1]); // NEAR PLANE
+}
+
+vec3 normalForward(const Scene& s, vec3 point, float d) {
+	vec2 delta = vec2(NORMAL_DELTA, 0.f);
+	vec3 gradient = vec3(
+		sdf(s, point - vec3(delta.x, delta.y, delta.y))[0],
+		sdf(s, point - vec3(delta.y, delta.x, delta.y))[0],
+		sdf(s, point - vec3(delta.y, delta.y, delta.x))[0]
+	);
+	return normalize(d - gradient);
+}
+vec3 normalTetrahedral(const Scene& s, vec3 point) {
+	float h = NORMAL_DELTA * 0.5773f;
+	vec3 a(1.f, -1.f, -1.f), b(-1.f, -1.f, 1.f), c(-1.f, 1.f, -1.f), d(1.f, 1.f, 1.f);
+	return normalize(
+		a * sdf(s, point + a * h)[0] +
+		b * sdf(s, point + b * h)[0] +
+		c * sdf(s, point + c * h)[0] +
+		d * sdf(s, point + d * h)[0]
+	);
+}
+
+// Inverse of rotXY/rotZY for gradients.
+void unrotXY(vec3& v, const mat2& m) { vec2 r = m * vec2(v.x, v.y); v.x = r.x; v.y = r.y; }
+void unrotZY(vec3& v, const mat2& m) { vec2 r = m * vec2(v.z, v.y); v.z = r.x; v.y = r.y; }
+
+vec3 gradBox(vec3 p, vec3 b) {
+	vec3 q = glm::abs(p) - b;
+	if (glm::max(q.x, glm::max(q.y, q.z)) > 0.f)
+		return glm::sign(p) * normalize(glm::max(q, 0.f));
+	return glm::sign(p) * glm::step(vec3(q.y, q.z, q.x), q) * glm::step(vec3(q.z, q.x, q.y), q);
+}
+vec3 gradTorus(vec3 p, float r1) {
+	vec2 q = vec2(length(vec2(p.x, p.y)) - r1, p.z);
+	vec2 xy = normalize(vec2(p.x, p.y)) * q.x;
+	return normalize(vec3(xy.x, xy.y, q.y));
+}
+// See normalAnalytic() in screen.frag.
+vec3 normalAnalytic(const Scene& s, vec3 p) {
+	float time = s.time;
+	float d = glm::abs(p.y + 10.f) - 0.015f;
+	vec3 g = vec3(0.f, glm::sign(p.y + 10.f), 0.f);
+	bool closed = true;
+
+	// SPINNER
+	vec3 spinnerPos = p;
+	spinnerPos.y += 0.1f * glm::sin(time * TAU * 0.0004f);
+	float ball = sdfSphere(spinnerPos, 1.f);
+	if (ball < d) {
+		d = ball;
+		g = normalize(spinnerPos);
+	}
+	mat2 m1 = rotationMatrix(time * 0.0014286f), m2 = rotationMatrix(time * 0.0025f);
+	rotXY(spinnerPos, m1);
+	rotZY(spinnerPos, m2);
+	float ring = sdfTorus(spinnerPos, 1.5f, 0.1f);
+	if (ring < d) {
+		d = ring;
+		g = gradTorus(spinnerPos, 1.5f);
+		unrotZY(g, m2);
+		unrotXY(g, m1);
+	}
+	mat2 m3 = rotationMatrix(-6.f * glm::sin(time * 0.0005263f)), m4 = rotationMatrix(time * 0.001f);
+	rotXY(spinnerPos, m3);
+	rotZY(spinnerPos, m4);
+	ring = sdfTorus(spinnerPos, 2.f, 0.1f);
+	if (ring < d) {
+		d = ring;
+		g = gradTorus(spinnerPos, 2.f);
+		unrotZY(g, m4);
+		unrotXY(g, m3);
+		unrotZY(g, m2);
+		unrotXY(g, m1);
+	}
+
+	// MIRRORS
+	vec3 mirpos = p - vec3(0.f, 9.f, 0.f);
+	mirpos.x = glm::abs(mirpos.x) - 5.f;
+	mirpos.z = glm::abs(mirpos.z) - 5.f;
+	rotXZ(mirpos, rotationMatrix(PI / 4.f));
+	rotZY(mirpos, rotationMatrix(-PI / 6.f));
+	mirpos.y += 0.5f * glm::sin(mirpos.x * mirpos.z + time * 0.003f);
+	float mir = sdfBox(mirpos, vec3(1.8f + 0.1f * glm::sin(TAU * mirpos.y * mirpos.z + time * 0.005f), 2.f, 0.3f)) - 0.2f;
+	if (mir < d) {
+		d = mir * 0.5f;
+		closed = false;
+	}
+
+	// RHOMBIC ICOSAHEDRON
+	vec3 icosp = p - vec3(0.f, 10.f, 0.f);
+	rotXZ(icosp, rotationMatrix(time * 0.001f));
+	float icos = sdfRhombicIcos(icosp, 1.f);
+	if (icos < d) {
+		d = icos;
+		closed = false;
+	}
+
+	// MORPHING BOX
+	vec3 mpos = p - vec3(10.f, -6.f, 0.f);
+	float blend = glm::smoothstep(-.2f, 1.f, glm::sin(time * 0.002f));
+	float morph = glm::mix(sdfBox(mpos, vec3(1.8f)) - 0.2f, sdfSphere(mpos, 2.f), blend);
+	if (morph < d) {
+		d = morph * 0.9f;
+		g = glm::mix(gradBox(mpos, vec3(1.8f)), normalize(mpos), blend);
+		closed = true;
+	}
+
+	// NEAR PLANE
+	if (NEAR - length(p - s.u.cam) * 0.9f > d) {
+		g = s.u.cam - p;
+		closed = true;
+	}
+
+	return closed ? normalize(g) : normalTetrahedral(s, p);
+}
+
+vec3 normal(const Scene& s, vec3 point, float d) {
+	switch (s.normals) {
+		case 1: return normalTetrahedral(s, point);
+		case 2: return normalAnalytic(s, point);
+		default: return normalForward(s, point, d);
+	}
+}
+vec3 normal(const Scene& s, vec3 point) {
+	return normal(s, point, s.normals == 0 ? sdf(s, point)[0] : 0.f);
+}
+
+vec3 trace(const Scene& s, vec3 ro, vec3 rd, int steps, float side) {
+	float dist = 0.f;
+	float omega = RELAXATION, stepLength = 0.f, prevRadius = 0.f;
+
+	vec2 data = vec2(0.f);
+	for (int i = 0; i < steps; i++) {
+		data = sdf(s, ro + rd * dist);
+		data[0] *= side;
+
+		float radius = glm::abs(data[0]);
+		if (omega > 1.f && radius + prevRadius < stepLength) {
+			dist -= stepLength - prevRadius;
+			stepLength = prevRadius;
+			omega = 1.f;
+			continue;
+		}
+
+		if (radius < HIT || dist > FAR)
+			break;
+
+		stepLength = data[0] * omega;
+		prevRadius = radius;
+		dist += stepLength;
+	}
+	return vec3(dist, data[1], data[0]);
+}
+
+vec3 getTexel(int matID, vec3 p) {
+	switch (matID) {
+	case 0:
+		return vec3(0.f);
+	case 1:
+		rotXZ(p, rotationMatrix(PI / 4.f));
+		return vec3(material(1).albedo) * (0.5f + 0.5f * glm::ceil(sat(glm::sin(1.5f * p.x) + glm::sin(1.5f * p.z))));
+	default:
+		return vec3(material(matID).albedo);
+	}
+}
+
+float calculateAO(const Scene& s, vec3 p, vec3 n) {
+	float r = 0.f, w = 1.f, d;
+
+	for (float i = 1.f; i < AO_SAMPLES + 1.1f; i++) {
+		d = i / AO_SAMPLES;
+		r += w * (d - sdf(s, p + n * d)[0]);
+		w *= 0.5f;
+	}
+
+	return 1.f - sat(r);
+}
+
+vec3 lighting(const Scene& s, const Ray& ray, vec3 texel) {
+	vec3 ambient = AMBIENT_PERCENT, diffuse = vec3(0.f), specular = vec3(0.f);
+	for (int i = 0; i < LIGHT_COUNT; i++) {
+		const PointLight& light = s.lights[i];
+		vec3 lightVector = light.pos - ray.hitp;
+		float lightDistance = length(lightVector);
+
+		if (lightDistance > light.radius) continue;
+
+		lightVector = normalize(lightVector);
+
+		float fade = sat(1.f - glm::pow(lightDistance / light.radius, 4.f));
+		float attenuation = fade * fade / (lightDistance * 0.5f);
+
+		ambient += vec3(light.col) * attenuation;
+		diffuse += vec3(light.col) * sat(dot(ray.hitn, lightVector)) * light.col.a * attenuation;
+
+		vec3 halfway = normalize(normalize(ray.ro - ray.hitp) + lightVector);
+		float specularIntensity = glm::pow(sat(dot(ray.hitn, halfway)), glm::max(ray.mat.metal * SPECULAR_FALLOFF, 1.f));
+		specular += vec3(light.col) * light.col.a * specularIntensity * attenuation;
+	}
+
+	float occ = 1.f;
+	if (AO == 1)
+		occ = calculateAO(s, ray.hitp, ray.hitn);
+
+	vec3 global = occ * (AMBIENT * ambient + DIFFUSE * diffuse + SPECULAR * specular) + EMISSIVE * ray.mat.albedo.a;
+	return texel * global;
+}
+
+void refractt(const Scene& s, Ray& ray) {
+	ray.hitn = normal(s, ray.hitp);
+
+	ray.ro = ray.hitp - ray.hitn * HIT * 4.f;
+	vec3 rdent = glm::refract(ray.rd, ray.hitn, 1.f / ray.mat.iref);
+
+	float dI = trace(s, ray.ro, rdent, STEPS, -1.f)[0];
+
+	ray.ro += rdent * dI;
+	ray.hitn = -normal(s, ray.ro);
+
+	ray.rd = glm::refract(rdent, ray.hitn, ray.mat.iref);
+	if (dot(ray.rd, ray.rd) == 0.f) {
+		ray.rd = glm::reflect(rdent, ray.hitn);
+		dI = trace(s, ray.ro + ray.hitn * HIT * 4.f, ray.rd, STEPS, -1.f)[0];
+		ray.ro += ray.rd * dI;
+		ray.hitn = -normal(s, ray.ro);
+	}
+	ray.ro -= ray.hitn * HIT * 4.f;
+}
+
+vec3 bounce(const Scene& s, Ray& ray) {
+	vec3 bg = bgcol(s, ray.rd);
+
+	ray.hit = trace(s, ray.ro, ray.rd, STEPS, 1.f);
+	if (ray.hit[0] > FAR)
+		return bg;
+
+	ray.mat = material(int(ray.hit[1]));
+
+	ray.hitp = ray.ro + ray.rd * ray.hit[0];
+	ray.hitn = normal(s, ray.hitp, ray.hit[2]);
+
+	vec3 texCol = getTexel(int(ray.hit[1]), ray.hitp);
+
+	if (ray.mat.rough == 1.f)
+		texCol *= lighting(s, ray, texCol);
+
+	if (ray.mat.rough > 0.f && ray.mat.iref > 1.f)
+		refractt(s, ray);
+
+	if (ray.mat.rough == 0.f) {
+		ray.ro = ray.hitp;
+		ray.ro += ray.hitn * HIT;
+
+		ray.rd = glm::reflect(ray.rd, ray.hitn);
+	}
+
+	//BG FOG
+	texCol = glm::mix(texCol, bg, glm::smoothstep(0.f, FAR * FAR, ray.hit[0] * ray.hit[0]));
+	return texCol;
+}
+
+void surfcol(const Scene& s, vec3& pixelColor, Ray ray) {
+	for (; ray.hit[0] < FAR && ray.bounces < BOUNCES && ray.mat.rough < 1.f; ray.bounces++)
+		pixelColor += bounce(s, ray);
+
+	if (ray.bounces > 1)
+		pixelColor /= float(ray.bounces - 1);
+}
+
+vec3 LookAt(const Scene& s, vec2 uv) {
+	vec3 r = normalize(cross(vec3(0.f, 1.f, 0.f), s.u.look));
+	vec3 up = cross(r, s.u.look);
+
+	return normalize((uv.x * r - uv.y * up) * FOV + s.u.look);
+}
+vec3 PixelColor(const Scene& s, vec2 fragCoord) {
+	vec2 uv = (fragCoord - 0.5f * s.u.res) / s.u.res.y;
+	vec3 pixelColor = vec3(0.f);
+
+	Ray ray;
+	ray.ro = s.u.cam;
+	ray.rd = LookAt(s, uv);
+
+	surfcol(s, pixelColor, ray);
+
+	return pixelColor;
+}
+
+Scene buildScene(const FrameUniforms& u, int normals) {
+	Scene s;
+	s.u = u;
+	s.time = float(u.time);
+	s.normals = normals;
+
+	s.lights[0] = { 5.f * vec3(glm::sin(PI / 3.f), 2.f, glm::cos(PI / 3.f)), vec4(0.f, 0.f, 1.f, 1.f), 160.f };
+	s.lights[1] = { 5.f * vec3(glm::sin(2.f * PI / 3.f), 2.f, glm::cos(2.f * PI / 3.f)), vec4(1.f, 0.f, 0.f, 1.f), 160.f };
+	s.lights[2] = { 5.f * vec3(0.f, 2.f, 1.f), vec4(0.f, 1.f, 0.f, 1.f), 160.f };
+
+	// SPINNING LIGHTS
+	// The GPU gets these from LightBuffer, which spins them the same way. The CPU walks all three instead of clusters.
+	for (int i = 0; i < LIGHT_COUNT; i++)
+		rotXZ(s.lights[i].pos, rotationMatrix(float(u.time * i) * TAU * 0.0004f));
+
+	return s;
+}
+
+}
+
+void renderCPU(const FrameUniforms& u, std::vector<glm::vec3>& pixels, int threads, int normals) {
+	int wid = int(u.res.x), hei = int(u.res.y);
+	pixels.assign(size_t(wid) * hei, vec3(0.f));
+	if (wid <= 0 || hei <= 0)
+		return;
+
+	const Scene scene = buildScene(u, normals);
+
+	int tilesX = (wid + CPU_TILE - 1) / CPU_TILE;
+	int tilesY = (hei + CPU_TILE - 1) / CPU_TILE;
+	int tileCount = tilesX * tilesY;
+
+	if (threads <= 0)
+		threads = int(std::thread::hardware_concurrency());
+	if (threads <= 0)
+		threads = 1;
+	if (threads > tileCount)
+		threads = tileCount;
+
+	std::atomic<int> nextTile(0);
+	auto worker = [&]() {
+		for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+			int x0 = (tile % tilesX) * CPU_TILE, y0 = (tile / tilesX) * CPU_TILE;
+			int x1 = glm::min(x0 + CPU_TILE, wid), y1 = glm::min(y0 + CPU_TILE, hei);
+
+			for (int y = y0; y < y1; y++)
+				for (int x = x0; x < x1; x++)
+					pixels[size_t(y) * wid + x] = PixelColor(scene, vec2(x + 0.5f, y + 0.5f));
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int i = 1; i < threads; i++)
+		pool.emplace_back(worker);
+	worker();
+	for (auto& t : pool)
+		t.join();
+}
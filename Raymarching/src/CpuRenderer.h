@@ -0,0 +1,17 @@
+#pragma once
+#include "Raymarching.h"
+#include <vector>
+
+/*
+CPU REFERENCE RENDERER:
+  A straight port of screen.frag onto glm so frames can be rendered without a GPU.
+  The image is cut into CPU_TILE x CPU_TILE tiles which worker threads pull from a shared counter.
+
+  Pixels are stored bottom row first, the same order glReadPixels returns them in.
+*/
+
+#define CPU_TILE 16
+
+// threads <= 0 uses every hardware thread. normals picks the gradient like screen.frag's NORMALS: 0 forward
+// differences, 1 tetrahedral, 2 analytic.
+void renderCPU(const FrameUniforms& u, std::vector<glm::vec3>& pixels, int threads = 0, int normals = 0);
@@ -0,0 +1,169 @@
+#include "DeferredShading.h"
+#include "Raymarching.h"
+#include "Clock.h"
+#include <glm/glm.hpp>
+#include <stdio.h>
+#include <string>
+
+static GLuint genTarget(GLenum format, glm::ivec2 size) {
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, size.x, size.y, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+DeferredShading::DeferredShading(UniformBinding& uniforms, const char* defines) {
+	gbuffer = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define GBUFFER_PASS\n").c_str());
+	shading = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define SHADE_PASS\n").c_str());
+	sky = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define SKY_PASS\n").c_str());
+	uniforms.attach(gbuffer);
+	uniforms.attach(shading);
+	uniforms.attach(sky);
+
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	for (GLuint program : { shading, sky }) {
+		glUseProgram(program);
+		GLint loc;
+		if ((loc = uniforms.location(program, "gNormal")) != -1)
+			glUniform1i(loc, DEFERRED_NORMAL_UNIT);
+		if ((loc = uniforms.location(program, "gHit")) != -1)
+			glUniform1i(loc, DEFERRED_HIT_UNIT);
+	}
+	glUseProgram(previous);
+}
+DeferredShading::~DeferredShading() {
+	release();
+	glDeleteProgram(gbuffer);
+	glDeleteProgram(shading);
+	glDeleteProgram(sky);
+}
+
+void DeferredShading::allocate(glm::ivec2 size) {
+	release();
+	this->size = size;
+
+	const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+
+	normal = genTarget(GL_RGBA16F, size);
+	hit = genTarget(GL_RGBA32F, size);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+
+	glGenFramebuffers(1, &gFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, gFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, hit, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	glDrawBuffers(2, buffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("G-buffer %dx%d is incomplete\n", size.x, size.y);
+
+	color = genTarget(GL_RGBA16F, size);
+	shadeHit = genTarget(GL_RGBA32F, size);
+
+	glGenFramebuffers(1, &shadeFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, shadeFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, shadeHit, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	glDrawBuffers(2, buffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Deferred shading framebuffer %dx%d is incomplete\n", size.x, size.y);
+}
+
+void DeferredShading::release() {
+	if (gFBO == 0)
+		return;
+	glDeleteFramebuffers(1, &gFBO);
+	glDeleteFramebuffers(1, &shadeFBO);
+	glDeleteTextures(1, &normal);
+	glDeleteTextures(1, &hit);
+	glDeleteTextures(1, &color);
+	glDeleteTextures(1, &shadeHit);
+	glDeleteRenderbuffers(1, &depth);
+	gFBO = 0;
+}
+
+void DeferredShading::render(glm::ivec2 frame, GLuint vertexbuffer, double* stageMs) {
+	GLint outer = 0, previous = 0, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	frame = glm::max(frame, glm::ivec2(1));
+	if (frame != size)
+		allocate(frame);
+
+	long long mark = nowNanos();
+	auto stage = [&](int i) {
+		if (stageMs == NULL)
+			return;
+		glFinish();
+		long long now = nowNanos();
+		stageMs[i] = (now - mark) * 1e-6;
+		mark = now;
+	};
+
+	// G-BUFFER: every pixel writes its depth, so nothing needs clearing.
+	glBindFramebuffer(GL_FRAMEBUFFER, gFBO);
+	glViewport(0, 0, size.x, size.y);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glUseProgram(gbuffer);
+	drawScreen(vertexbuffer);
+	stage(0);
+
+	// SHADING: the quad sits at depth 0.5, between the sky's 0 and the surfaces' 1.
+	glActiveTexture(GL_TEXTURE0 + DEFERRED_NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D, normal);
+	glActiveTexture(GL_TEXTURE0 + DEFERRED_HIT_UNIT);
+	glBindTexture(GL_TEXTURE_2D, hit);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, shadeFBO);
+	glUseProgram(shading);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LESS);
+	drawScreen(vertexbuffer);
+	stage(1);
+	glDepthFunc(GL_GREATER);
+	glUseProgram(sky);
+	drawScreen(vertexbuffer);
+	stage(2);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glDisable(GL_DEPTH_TEST);
+
+	// Color into the outer framebuffer, and the hit too when it takes one, like the temporal cache's.
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, shadeFBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outer);
+	GLint draw[2] = { GL_NONE, GL_NONE };
+	glGetIntegerv(GL_DRAW_BUFFER0, &draw[0]);
+	glGetIntegerv(GL_DRAW_BUFFER1, &draw[1]);
+	if (outer != 0 && draw[1] == GL_COLOR_ATTACHMENT1) {
+		for (int i = 0; i < 2; i++) {
+			glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0 + i);
+			glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		}
+		const GLenum buffers[] = { GLenum(draw[0]), GLenum(draw[1]) };
+		glDrawBuffers(2, buffers);
+	}
+	else {
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	glUseProgram(previous);
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <vector>
+
+/*
+DEFERRED SHADING:
+  Splits screen.frag into passes. The G-buffer pass (GBUFFER_PASS) only marches the primary rays and writes every pixel's
+  normal and hit (position and material) to float targets, with a depth of 0 for sky and 1 for a surface. The shading
+  pass (SHADE_PASS) picks up from there with the texel, lighting, AO and the secondary bounces, and the sky pass
+  (SKY_PASS) fills in the background.
+
+  Both are drawn over that depth, the shading pass where only surface pixels pass the test and the sky pass where only
+  sky pixels do. Sky pixels are rejected before the big shader runs instead of idling next to lit ones, and the
+  marching, the surfaces and the sky can be timed on their own.
+
+  The color and the hit end up in the framebuffer that was bound, as a plain drawScreen() would leave them, so the cone
+  prepass and the temporal cache work around it unchanged.
+*/
+
+#define DEFERRED_NORMAL_UNIT 7
+#define DEFERRED_HIT_UNIT 8
+
+class DeferredShading {
+public:
+	// defines should be the ones the screen program was built with.
+	DeferredShading(UniformBinding& uniforms, const char* defines = "");
+	~DeferredShading();
+
+	// The programs to attach the cone prepass, temporal cache and brick map to, as with the screen program.
+	std::vector<GLuint> shaders() const { return { gbuffer, shading, sky }; }
+
+	// Renders a wid x hei frame with the Frame block already uploaded and puts the framebuffer, viewport and program back.
+	// With stageMs it finishes after every pass and stores the G-buffer, surface and sky times there, for the benchmark.
+	void render(glm::ivec2 frame, GLuint vertexbuffer, double* stageMs = NULL);
+
+private:
+	void allocate(glm::ivec2 size);
+	void release();
+
+	GLuint gbuffer = 0, shading = 0, sky = 0;
+
+	GLuint gFBO = 0, normal = 0, hit = 0, depth = 0; // G-buffer
+	GLuint shadeFBO = 0, color = 0, shadeHit = 0; // shares the depth
+
+	glm::ivec2 size = glm::ivec2(0);
+};
@@ -0,0 +1,53 @@
+#include "DynamicResolution.h"
+#include "Raymarching.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+DynamicResolution::DynamicResolution(double targetMs, float minScale, float maxScale)
+	: target(targetMs), minScale(minScale), maxScale(maxScale), current(maxScale) {}
+
+DynamicResolution::~DynamicResolution() {
+	if (FBO != 0) {
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteTextures(1, &color);
+	}
+}
+
+glm::ivec2 DynamicResolution::begin(int winWid, int winHei) {
+	window = glm::max(glm::ivec2(winWid, winHei), glm::ivec2(1));
+
+	if (window != allocated) {
+		if (FBO != 0) {
+			glDeleteFramebuffers(1, &FBO);
+			glDeleteTextures(1, &color);
+		}
+		genFramebuffer(&FBO, &color, window.x, window.y);
+		allocated = window;
+	}
+
+	render = glm::max(glm::ivec2(glm::vec2(window) * current + 0.5f), glm::ivec2(1));
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, render.x, render.y);
+	return render;
+}
+
+void DynamicResolution::end() {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, render.x, render.y, 0, 0, window.x, window.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, window.x, window.y);
+}
+
+void DynamicResolution::update(double gpuMs) {
+	if (gpuMs <= 0.0)
+		return;
+
+	float wanted = current * (float)glm::sqrt(target / gpuMs);
+	wanted = glm::clamp(wanted, minScale, maxScale);
+	if (glm::abs(wanted - current) < DYNRES_DEADBAND)
+		return;
+
+	current = glm::clamp(current + (wanted - current) * DYNRES_DAMPING, minScale, maxScale);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <glm/vec2.hpp>
+
+/*
+DYNAMIC RESOLUTION:
+  screen.frag renders into the lower left corner of an offscreen target sized to the window, and end() stretches that
+  corner over the window with a linear blit. The corner's size is the window size times scale().
+
+  update() is fed the measured GPU time of a frame and moves the scale towards the one that would have hit the target.
+  Pixel cost is roughly linear in area, so the correction is the square root of target/measured. It only moves a fraction
+  of the way per sample since the measurement is a few frames old, and ignores changes under DYNRES_DEADBAND.
+*/
+
+#define DYNRES_MIN_SCALE 0.25f
+#define DYNRES_MAX_SCALE 1.0f
+#define DYNRES_DAMPING 0.3f
+#define DYNRES_DEADBAND 0.02f
+
+class DynamicResolution {
+public:
+	DynamicResolution(double targetMs, float minScale = DYNRES_MIN_SCALE, float maxScale = DYNRES_MAX_SCALE);
+	~DynamicResolution();
+
+	// Binds the offscreen target, sets the viewport and returns the size to render at.
+	glm::ivec2 begin(int winWid, int winHei);
+	// Upscales what was rendered since begin() onto the default framebuffer.
+	void end();
+
+	void update(double gpuMs);
+	float scale() const { return current; }
+
+private:
+	double target;
+	float minScale, maxScale, current;
+
+	unsigned int FBO = 0, color = 0;
+	glm::ivec2 allocated = glm::ivec2(0), window = glm::ivec2(0), render = glm::ivec2(0);
+};
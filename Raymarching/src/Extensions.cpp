@@ -0,0 +1,44 @@
+#include "Extensions.h"
+#include <GLFW/glfw3.h>
+#include <string.h>
+
+GLExtensions GLEXT = {};
+
+bool hasExtension(const char* name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext != NULL && strcmp(ext, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool atLeast(int major, int minor) {
+	GLint ma = 0, mi = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &ma);
+	glGetIntegerv(GL_MINOR_VERSION, &mi);
+	return ma > major || (ma == major && mi >= minor);
+}
+
+void loadExtensions() {
+	GLEXT = {};
+
+	if (atLeast(4, 1) || hasExtension("GL_ARB_get_program_binary")) {
+		GLEXT.GetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+		GLEXT.ProgramBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+		GLEXT.ProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		GLEXT.programBinary = GLEXT.GetProgramBinary && GLEXT.ProgramBinary && GLEXT.ProgramParameteri && formats > 0;
+	}
+
+	// Both name the same enums, only the entry point differs.
+	if (hasExtension("GL_KHR_parallel_shader_compile"))
+		GLEXT.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	else if (hasExtension("GL_ARB_parallel_shader_compile"))
+		GLEXT.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	GLEXT.parallelCompile = GLEXT.MaxShaderCompilerThreads != NULL;
+}
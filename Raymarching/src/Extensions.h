@@ -0,0 +1,42 @@
+#pragma once
+#include <glad/glad.h>
+
+/*
+GL EXTENSIONS:
+  glad in include/ was generated for core 4.0 with no extensions. Entry points past that are loaded here by hand
+  after the context is created, and the flags below say which of them the driver actually has.
+*/
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+struct GLExtensions {
+	bool programBinary; // GL 4.1 or ARB_get_program_binary
+
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary;
+	PFNGLPROGRAMBINARYPROC ProgramBinary;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri;
+
+	bool parallelCompile; // KHR_parallel_shader_compile or ARB_parallel_shader_compile
+
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads;
+};
+extern GLExtensions GLEXT;
+
+// Call once the context is current and glad is loaded.
+void loadExtensions();
+bool hasExtension(const char* name);
@@ -0,0 +1,102 @@
+#include "InputRecord.h"
+#include <GLFW/glfw3.h>
+
+#define INPUT_RECORD_MAGIC 0x52494d52u // "RMIR"
+
+const int INPUT_KEYS[INPUT_KEY_COUNT] = {
+	// timeFlow()
+	GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_E, GLFW_KEY_4, GLFW_KEY_5,
+	// input()
+	GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D, GLFW_KEY_SPACE, GLFW_KEY_LEFT_SHIFT,
+	GLFW_KEY_LEFT_ALT, GLFW_KEY_LEFT_CONTROL,
+	GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT,
+	// quality tiers
+	GLFW_KEY_F1, GLFW_KEY_F2, GLFW_KEY_F3, GLFW_KEY_F4
+};
+
+unsigned int pollKeys(GLFWwindow* window) {
+	unsigned int keys = 0;
+	for (int i = 0; i < INPUT_KEY_COUNT; i++)
+		if (glfwGetKey(window, INPUT_KEYS[i]) == GLFW_PRESS)
+			keys |= 1u << i;
+	return keys;
+}
+bool keyInMask(unsigned int keys, int glfwKey) {
+	for (int i = 0; i < INPUT_KEY_COUNT; i++)
+		if (INPUT_KEYS[i] == glfwKey)
+			return (keys >> i) & 1u;
+	return false;
+}
+
+InputRecorder::~InputRecorder() {
+	close();
+}
+bool InputRecorder::open(const char* path, const InputSession& start) {
+	close();
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Impossible to open %s for writing.\n", path);
+		return false;
+	}
+
+	unsigned int magic = INPUT_RECORD_MAGIC, version = INPUT_RECORD_VERSION;
+	fwrite(&magic, sizeof(magic), 1, file);
+	fwrite(&version, sizeof(version), 1, file);
+	fwrite(&start.ro[0], sizeof(float), 3, file);
+	fwrite(&start.fwd[0], sizeof(float), 3, file);
+	fwrite(&start.up[0], sizeof(float), 3, file);
+	fwrite(&start.pitch, sizeof(float), 1, file);
+	fwrite(&start.yaw, sizeof(float), 1, file);
+	fwrite(&start.scroll, sizeof(int), 1, file);
+	fwrite(&start.time, sizeof(double), 1, file);
+	return true;
+}
+void InputRecorder::record(unsigned int keys, long long dTNanos) {
+	if (file == NULL)
+		return;
+	fwrite(&keys, sizeof(keys), 1, file);
+	fwrite(&dTNanos, sizeof(dTNanos), 1, file);
+}
+void InputRecorder::close() {
+	if (file != NULL)
+		fclose(file);
+	file = NULL;
+}
+
+InputReplay::~InputReplay() {
+	close();
+}
+bool InputReplay::open(const char* path, InputSession& start) {
+	close();
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		printf("Impossible to open %s.\n", path);
+		return false;
+	}
+
+	unsigned int magic = 0, version = 0;
+	bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && fread(&version, sizeof(version), 1, file) == 1
+		&& magic == INPUT_RECORD_MAGIC && version == INPUT_RECORD_VERSION
+		&& fread(&start.ro[0], sizeof(float), 3, file) == 3
+		&& fread(&start.fwd[0], sizeof(float), 3, file) == 3
+		&& fread(&start.up[0], sizeof(float), 3, file) == 3
+		&& fread(&start.pitch, sizeof(float), 1, file) == 1
+		&& fread(&start.yaw, sizeof(float), 1, file) == 1
+		&& fread(&start.scroll, sizeof(int), 1, file) == 1
+		&& fread(&start.time, sizeof(double), 1, file) == 1;
+	if (!ok) {
+		printf("%s is not an input recording (version %d).\n", path, INPUT_RECORD_VERSION);
+		close();
+	}
+	return ok;
+}
+bool InputReplay::next(unsigned int& keys, long long& dTNanos) {
+	if (file == NULL)
+		return false;
+	return fread(&keys, sizeof(keys), 1, file) == 1 && fread(&dTNanos, sizeof(dTNanos), 1, file) == 1;
+}
+void InputReplay::close() {
+	if (file != NULL)
+		fclose(file);
+	file = NULL;
+}
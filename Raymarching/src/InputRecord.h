@@ -0,0 +1,51 @@
+#pragma once
+#include <glm/vec3.hpp>
+#include <stdio.h>
+
+struct GLFWwindow;
+
+/*
+INPUT RECORDING:
+  Each frame the keys input(), timeFlow() and the quality tiers look at are packed into a bit mask (bit i is INPUT_KEYS[i]) and written
+  together with that frame's dT in nanoseconds, 12 bytes a frame. The header holds the camera and time state the session
+  started from, so a replay fed the same masks and dTs walks through exactly the same ro/fwd/pitch/yaw/epoch states.
+
+  File layout, little endian:
+    'RMIR' u32 version  f32 ro[3] fwd[3] up[3] pitch yaw  i32 scroll  f64 time_ms  { u32 keys  i64 dT_ns }...
+*/
+
+#define INPUT_RECORD_VERSION 2
+#define INPUT_KEY_COUNT 21
+
+extern const int INPUT_KEYS[INPUT_KEY_COUNT];
+
+unsigned int pollKeys(GLFWwindow* window);
+bool keyInMask(unsigned int keys, int glfwKey);
+
+struct InputSession {
+	glm::vec3 ro, fwd, up;
+	float pitch, yaw;
+	int scroll;
+	double time; // ms, the 'time' uniform when the session started
+};
+
+class InputRecorder {
+public:
+	~InputRecorder();
+	bool open(const char* path, const InputSession& start);
+	void record(unsigned int keys, long long dTNanos);
+	void close();
+private:
+	FILE* file = NULL;
+};
+
+class InputReplay {
+public:
+	~InputReplay();
+	bool open(const char* path, InputSession& start);
+	// False once the recording is exhausted.
+	bool next(unsigned int& keys, long long& dTNanos);
+	void close();
+private:
+	FILE* file = NULL;
+};
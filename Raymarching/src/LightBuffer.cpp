@@ -0,0 +1,164 @@
+#include "LightBuffer.h"
+#include <glm/glm.hpp>
+#include <float.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define PI 3.141592f
+#define TAU (2.f * PI)
+
+#define EXTRA_RADIUS 6.f
+#define EXTRA_HEIGHT -9.f // a unit over the ground
+#define EXTRA_SPREAD 20.f
+#define EXTRA_SPIN (TAU * 0.00002f)
+
+LightBuffer::LightBuffer(int extra, const std::vector<LightSource>* scene) {
+	if (scene != NULL) {
+		for (const LightSource& s : *scene) {
+			if (count() == MAX_LIGHTS) {
+				printf("Light buffer: only room for %d lights\n", MAX_LIGHTS);
+				break;
+			}
+			base.push_back(s.light);
+			spin.push_back(s.spin);
+		}
+	}
+	else {
+		base.push_back({ 5.f * glm::vec3(glm::sin(PI / 3.f), 2.f, glm::cos(PI / 3.f)), 160.f, glm::vec4(0.f, 0.f, 1.f, 1.f) });
+		base.push_back({ 5.f * glm::vec3(glm::sin(2.f * PI / 3.f), 2.f, glm::cos(2.f * PI / 3.f)), 160.f, glm::vec4(1.f, 0.f, 0.f, 1.f) });
+		base.push_back({ 5.f * glm::vec3(0.f, 2.f, 1.f), 160.f, glm::vec4(0.f, 1.f, 0.f, 1.f) });
+		for (int i = 0; i < count(); i++)
+			spin.push_back(float(i) * TAU * 0.0004f);
+	}
+
+	if (extra > MAX_LIGHTS - count()) {
+		printf("Light buffer: only room for %d extra lights\n", MAX_LIGHTS - count());
+		extra = MAX_LIGHTS - count();
+	}
+	// Fixed seed, so every run and every benchmark sees the same lights.
+	unsigned int seed = 12345u;
+	auto next = [&]() {
+		seed = seed * 1664525u + 1013904223u;
+		return float(seed >> 8) / float(1 << 24);
+	};
+	for (int i = 0; i < extra; i++) {
+		glm::vec3 pos(EXTRA_SPREAD * (2.f * next() - 1.f), EXTRA_HEIGHT, EXTRA_SPREAD * (2.f * next() - 1.f));
+		glm::vec3 col(next(), next(), next());
+		col /= glm::max(col.r, glm::max(col.g, col.b));
+		spin.push_back(count() % 2 ? EXTRA_SPIN : -EXTRA_SPIN); // slowly both ways round
+		base.push_back({ pos, EXTRA_RADIUS, glm::vec4(col, 1.f) });
+	}
+
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BINDING, UBO);
+
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	glm::ivec3 dim = CLUSTER_DIM;
+	glGenBuffers(1, &TBO);
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned int) * 2 * dim.x * dim.y * dim.z, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0 + LIGHT_CLUSTER_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, TBO);
+	glActiveTexture(GL_TEXTURE0);
+}
+LightBuffer::~LightBuffer() {
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &TBO);
+	glDeleteBuffers(1, &UBO);
+}
+
+void LightBuffer::attach(GLuint program, const UniformBinding& uniforms) {
+	GLuint block = glGetUniformBlockIndex(program, "Lights");
+	if (block != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, block, LIGHT_BINDING);
+
+		GLint size = 0;
+		glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		if (size != (GLint)sizeof(LightBlock))
+			printf("Lights block is %d bytes in the shader but %d in LightBlock\n", size, (int)sizeof(LightBlock));
+	}
+
+	GLint loc = uniforms.location(program, "clusterLights");
+	if (loc != -1) {
+		GLint previous = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+		glUseProgram(program);
+		glUniform1i(loc, LIGHT_CLUSTER_UNIT);
+		glUseProgram(previous);
+	}
+}
+
+void LightBuffer::update(double time) {
+	LightBlock block;
+	glm::ivec3 dim = CLUSTER_DIM;
+	glm::vec3 cell = (CLUSTER_MAX - CLUSTER_MIN) / glm::vec3(dim);
+	block.clusterMin = CLUSTER_MIN;
+	block.clusterCell = cell;
+	block.lightCount = count();
+	block.pad = 0.f;
+
+	// SPINNING LIGHTS: each at its own rate.
+	for (int i = 0; i < count(); i++) {
+		LightEntry l = base[i];
+		float angle = float(time) * spin[i];
+		float s = glm::sin(angle), c = glm::cos(angle);
+		l.pos = glm::vec3(c * l.pos.x - s * l.pos.z, l.pos.y, s * l.pos.x + c * l.pos.z);
+		block.lights[i] = l;
+	}
+
+	// CLUSTERS: every light goes into the cells its sphere touches. The border cells reach out to infinity, which the
+	// clamped range of cells a light can touch already accounts for.
+	int cells = dim.x * dim.y * dim.z;
+	lists.resize(cells);
+	for (auto& list : lists)
+		list.clear();
+
+	for (int i = 0; i < count(); i++) {
+		const LightEntry& l = block.lights[i];
+		glm::ivec3 lo = glm::clamp(glm::ivec3(glm::floor((l.pos - l.radius - CLUSTER_MIN) / cell)), glm::ivec3(0), dim - 1);
+		glm::ivec3 hi = glm::clamp(glm::ivec3(glm::floor((l.pos + l.radius - CLUSTER_MIN) / cell)), glm::ivec3(0), dim - 1);
+		for (int z = lo.z; z <= hi.z; z++)
+			for (int y = lo.y; y <= hi.y; y++)
+				for (int x = lo.x; x <= hi.x; x++) {
+					glm::ivec3 c(x, y, z);
+					glm::vec3 bmin = CLUSTER_MIN + glm::vec3(c) * cell, bmax = bmin + cell;
+					for (int k = 0; k < 3; k++) {
+						if (c[k] == 0) bmin[k] = -FLT_MAX;
+						if (c[k] == dim[k] - 1) bmax[k] = FLT_MAX;
+					}
+					glm::vec3 d = glm::clamp(l.pos, bmin, bmax) - l.pos;
+					if (glm::dot(d, d) <= l.radius * l.radius)
+						lists[x + dim.x * (y + dim.y * z)].push_back(i);
+				}
+	}
+
+	clusters.resize(size_t(2) * cells);
+	for (int i = 0; i < cells; i++) {
+		unsigned int offset = (unsigned int)clusters.size(), n = (unsigned int)lists[i].size();
+		if (clusters.size() + n > size_t(maxTexels)) {
+			if (!overflowed)
+				printf("Light buffer: the clusters need more than %d texels, dropping lights\n", maxTexels);
+			overflowed = true;
+			n = glm::max(0, int(maxTexels - clusters.size()));
+		}
+		clusters[2 * i] = offset;
+		clusters[2 * i + 1] = n;
+		clusters.insert(clusters.end(), lists[i].begin(), lists[i].begin() + n);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, offsetof(LightBlock, lights) + sizeof(LightEntry) * count(), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// Orphan last frame's clusters instead of waiting for the draws that still read them.
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(unsigned int) * clusters.size(), clusters.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
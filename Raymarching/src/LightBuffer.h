@@ -0,0 +1,76 @@
+#pragma once
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+/*
+LIGHT BUFFER:
+  The scene's point lights live here instead of in screen.frag. Once a frame update() moves them to the frame's time,
+  sorts them into a world space grid of clusters and uploads both, so lighting() neither animates them per pixel nor
+  loops over every light for every hit.
+
+  The lights go up in the std140 block 'Lights' on binding point LIGHT_BINDING. The clusters go up in an R32UI texture
+  buffer: for every cell its offset and count, then the light indices the offsets point at. A cell lists every light
+  whose radius reaches into it, and the cells on the border of the grid reach out to infinity, so any hit anywhere finds
+  every light that can touch it in the cell it clamps to.
+
+  GL 3.3 has no storage buffers, and a texture buffer takes lists of any length where a uniform block is only sure to
+  hold 16 KB.
+*/
+
+#define LIGHT_BINDING 1
+#define LIGHT_CLUSTER_UNIT 9
+#define MAX_LIGHTS 256 // screen.frag has the same
+
+// Around the mirrors and the spinner, from just under the ground up past the lights.
+#define CLUSTER_MIN glm::vec3(-24.f, -12.f, -24.f)
+#define CLUSTER_MAX glm::vec3(24.f, 20.f, 24.f)
+#define CLUSTER_DIM glm::ivec3(12, 8, 12) // screen.frag has the same
+
+// std140 mirror of the Lights block's light.
+struct LightEntry {
+	glm::vec3 pos;
+	float radius;
+	glm::vec4 col; // rgb color, a diffuse and specular strength
+};
+
+// A light where it is at time 0 and how fast it circles the y axis, radians per ms.
+struct LightSource {
+	LightEntry light;
+	float spin;
+};
+
+// std140 mirror of the Lights block.
+struct LightBlock {
+	glm::vec3 clusterMin;
+	int lightCount;
+	glm::vec3 clusterCell;
+	float pad;
+	LightEntry lights[MAX_LIGHTS];
+};
+
+class LightBuffer {
+public:
+	// The three spinning lights of the scene, or a scene file's lights, and 'extra' small ones scattered over the ground.
+	LightBuffer(int extra = 0, const std::vector<LightSource>* scene = NULL);
+	~LightBuffer();
+
+	// Binds a program's Lights block and points its cluster sampler at the buffer.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	// Moves the lights to 'time' (ms), rebuilds the clusters and uploads both.
+	void update(double time);
+
+	int count() const { return int(base.size()); }
+
+private:
+	std::vector<LightEntry> base; // at time 0
+	std::vector<float> spin;
+	std::vector<std::vector<unsigned int>> lists; // per cell, kept to reuse their memory
+	std::vector<unsigned int> clusters;
+	GLuint UBO = 0, TBO = 0, texture = 0;
+	GLint maxTexels = 0;
+	bool overflowed = false;
+};
@@ -0,0 +1,157 @@
+#include "Profiler.h"
+#include "Clock.h"
+#include "Raymarching.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <stdio.h>
+
+FrameProfiler::FrameProfiler() : frames(PROFILE_FRAMES) {
+	for (Query& q : queries)
+		glGenQueries(1, &q.id);
+}
+FrameProfiler::~FrameProfiler() {
+	for (Query& q : queries)
+		glDeleteQueries(1, &q.id);
+}
+
+void FrameProfiler::beginFrame() {
+	collectQueries();
+
+	frameIndex++;
+	Frame& f = current();
+	f = Frame();
+	f.index = frameIndex;
+	f.start = nowNanos();
+	depth = 0;
+}
+void FrameProfiler::endFrame() {
+	if (frameIndex < 0)
+		return;
+	while (depth > 0)
+		endScope();
+	current().end = nowNanos();
+}
+
+void FrameProfiler::beginScope(const char* name) {
+	Frame& f = current();
+	if (frameIndex < 0 || f.scopeCount == PROFILE_MAX_SCOPES || depth == PROFILE_MAX_SCOPES)
+		return;
+	openScopes[depth++] = f.scopeCount;
+	f.scopes[f.scopeCount++] = { name, nowNanos(), 0 };
+}
+void FrameProfiler::endScope() {
+	if (depth == 0)
+		return;
+	current().scopes[openScopes[--depth]].end = nowNanos();
+}
+
+void FrameProfiler::beginGpu() {
+	if (frameIndex < 0 || gpuOpen)
+		return;
+
+	// The ring has one more query than the latency, so the slot reused here was issued long enough ago.
+	Query& q = queries[queryNext];
+	if (q.frame >= 0)
+		collectQueries();
+	if (q.frame >= 0)
+		return; // still not back, skip this frame rather than block
+
+	glBeginQuery(GL_TIME_ELAPSED, q.id);
+	q.frame = frameIndex;
+	current().gpuStart = nowNanos();
+	gpuOpen = true;
+}
+void FrameProfiler::endGpu() {
+	if (!gpuOpen)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	queryNext = (queryNext + 1) % (GPU_QUERY_LATENCY + 1);
+	gpuOpen = false;
+}
+
+void FrameProfiler::collectQueries() {
+	for (Query& q : queries) {
+		if (q.frame < 0 || (gpuOpen && q.frame == frameIndex))
+			continue;
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(q.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(q.id, GL_QUERY_RESULT, &elapsed);
+
+		// The frame may have been overwritten already if the ring wrapped.
+		Frame& f = frames[q.frame % PROFILE_FRAMES];
+		if (f.index == q.frame)
+			f.gpu = (long long)elapsed;
+		if (q.frame > latestGpuFrame) {
+			latestGpu = (long long)elapsed;
+			latestGpuFrame = q.frame;
+		}
+		q.frame = -1;
+	}
+}
+
+bool FrameProfiler::writeChromeTrace(const char* path) const {
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		printf("Impossible to open %s for writing.\n", path);
+		return false;
+	}
+
+	// Chrome trace timestamps are microseconds. tid 1 is the CPU, tid 2 the GPU.
+	fprintf(out, "{\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+	long long first = std::max(0LL, frameIndex - PROFILE_FRAMES + 1);
+	for (long long i = first; i <= frameIndex; i++) {
+		const Frame& f = frames[i % PROFILE_FRAMES];
+		if (f.index != i || f.end == 0)
+			continue;
+
+		fprintf(out, ",\n{\"name\":\"frame %lld\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", f.index, f.start * 1e-3, (f.end - f.start) * 1e-3);
+		for (int s = 0; s < f.scopeCount; s++)
+			fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}", jsonEscape(f.scopes[s].name).c_str(), f.scopes[s].start * 1e-3, (f.scopes[s].end - f.scopes[s].start) * 1e-3);
+		if (f.gpu >= 0)
+			fprintf(out, ",\n{\"name\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}", f.gpuStart * 1e-3, f.gpu * 1e-3);
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	return true;
+}
+
+bool FrameProfiler::writeSummaryCSV(const char* path) const {
+	std::map<std::string, std::vector<double>> samples;
+
+	long long first = std::max(0LL, frameIndex - PROFILE_FRAMES + 1);
+	for (long long i = first; i <= frameIndex; i++) {
+		const Frame& f = frames[i % PROFILE_FRAMES];
+		if (f.index != i || f.end == 0)
+			continue;
+
+		samples["frame"].push_back((f.end - f.start) * 1e-6);
+		for (int s = 0; s < f.scopeCount; s++)
+			samples[f.scopes[s].name].push_back((f.scopes[s].end - f.scopes[s].start) * 1e-6);
+		if (f.gpu >= 0)
+			samples["gpu"].push_back(f.gpu * 1e-6);
+	}
+
+	FILE* out = fopen(path, "w");
+	if (out == NULL) {
+		printf("Impossible to open %s for writing.\n", path);
+		return false;
+	}
+	fprintf(out, "scope,count,min_ms,median_ms,p99_ms\n");
+	for (auto& entry : samples) {
+		std::vector<double>& v = entry.second;
+		std::sort(v.begin(), v.end());
+		size_t p99 = std::min(v.size() - 1, size_t(v.size() * 0.99));
+		fprintf(out, "%s,%zu,%.4f,%.4f,%.4f\n", entry.first.c_str(), v.size(), v.front(), v[v.size() / 2], v[p99]);
+	}
+	fclose(out);
+	return true;
+}
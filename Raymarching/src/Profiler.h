@@ -0,0 +1,82 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+
+/*
+FRAME PROFILER:
+  Keeps the last PROFILE_FRAMES frames in a ring. Each frame holds its CPU scopes (timed with the active Clock) and the GPU
+  time of whatever ran between beginGpu() and endGpu(), measured with a GL_TIME_ELAPSED query.
+
+  Queries are only read once they report available, which is normally GPU_QUERY_LATENCY frames later, so the profiler
+  never stalls the pipeline. Frames whose query never came back keep a GPU time of -1 and are left out of the summary.
+
+  writeChromeTrace() output loads in chrome://tracing or Perfetto, writeSummaryCSV() gives min/median/p99 per scope.
+*/
+
+#define PROFILE_FRAMES 1024
+#define PROFILE_MAX_SCOPES 16
+#define GPU_QUERY_LATENCY 4
+
+class FrameProfiler {
+public:
+	FrameProfiler();
+	~FrameProfiler();
+
+	void beginFrame();
+	void endFrame();
+
+	// Scope names must be string literals, only the pointer is kept.
+	void beginScope(const char* name);
+	void endScope();
+
+	void beginGpu();
+	void endGpu();
+
+	// GPU time of the newest frame whose query has come back, -1 before the first one.
+	double lastGpuMs() const { return latestGpu < 0 ? -1.0 : latestGpu * 1e-6; }
+	long long lastGpuFrame() const { return latestGpuFrame; }
+
+	bool writeChromeTrace(const char* path) const;
+	bool writeSummaryCSV(const char* path) const;
+
+private:
+	struct Scope {
+		const char* name;
+		long long start, end;
+	};
+	struct Frame {
+		long long index = -1;
+		long long start = 0, end = 0;
+		long long gpuStart = 0, gpu = -1; // gpuStart is the CPU time the GPU work was submitted
+		int scopeCount = 0;
+		Scope scopes[PROFILE_MAX_SCOPES];
+	};
+	struct Query {
+		GLuint id = 0;
+		long long frame = -1;
+	};
+
+	Frame& current() { return frames[frameIndex % PROFILE_FRAMES]; }
+	void collectQueries();
+
+	std::vector<Frame> frames;
+	long long frameIndex = -1;
+	int openScopes[PROFILE_MAX_SCOPES]; // stack of scopes open in this frame
+	int depth = 0;
+
+	Query queries[GPU_QUERY_LATENCY + 1];
+	int queryNext = 0;
+	bool gpuOpen = false;
+
+	long long latestGpu = -1, latestGpuFrame = -1;
+};
+
+// Times the enclosing block as a CPU scope.
+struct ProfileScope {
+	ProfileScope(FrameProfiler* profiler, const char* name) : profiler(profiler) { if (profiler) profiler->beginScope(name); }
+	~ProfileScope() { if (profiler) profiler->endScope(); }
+	FrameProfiler* profiler;
+};
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(profiler, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(profiler, name)
@@ -0,0 +1,163 @@
+#include "ProgramBuilder.h"
+#include "Extensions.h"
+#include "Clock.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+
+ProgramBuilder::ProgramBuilder(GLFWwindow* share) : share(share) {
+	if (GLEXT.parallelCompile) {
+		GLEXT.MaxShaderCompilerThreads(0xFFFFFFFFu); // as many as the driver likes
+		how = PARALLEL;
+	}
+	else if (share != NULL && startWorker())
+		how = WORKER;
+}
+bool ProgramBuilder::startWorker() {
+	// Window creation belongs to the main thread, only making the context current happens on the worker.
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	context = glfwCreateWindow(1, 1, "Program builder", NULL, share);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (context == NULL) {
+		printf("Could not create a shared context, programs will build on the main thread\n");
+		share = NULL;
+		return false;
+	}
+	worker = std::thread(&ProgramBuilder::work, this);
+	return true;
+}
+ProgramBuilder::~ProgramBuilder() {
+	if (worker.joinable()) {
+		{
+			std::unique_lock<std::mutex> l(lock);
+			stopping = true;
+			queue.clear();
+		}
+		ready.notify_all();
+		worker.join();
+		glfwDestroyWindow(context);
+	}
+
+	for (auto& entry : jobs) {
+		Job& job = entry.second;
+		if (job.how == PARALLEL && job.started && !job.done)
+			finish(job);
+		glDeleteProgram(job.build.program);
+	}
+}
+
+const char* ProgramBuilder::modeName() const {
+	switch (how) {
+		case PARALLEL: return "the driver's parallel compile";
+		case WORKER: return "a worker thread";
+		default: return "the main thread";
+	}
+}
+
+int ProgramBuilder::start(const char* vertex, const char* fragment, const std::string& defines) {
+	std::unique_lock<std::mutex> l(lock);
+	int ticket = next++;
+	Job& job = jobs[ticket];
+	job.vertex = vertex;
+	job.fragment = fragment;
+	job.defines = defines;
+	job.how = how;
+
+	if (how == PARALLEL) {
+		// Returns as soon as the driver has the work, or the program if the binary cache had it.
+		double begin = nowMillis();
+		job.started = startProgram(vertex, fragment, defines.c_str(), job.build);
+		job.done = !job.started;
+		if (job.build.vertexShader != 0 && nowMillis() - begin > BUILDER_STALL && share != NULL) {
+			printf("The driver compiled for %.0f ms before returning, building on a worker thread from now on\n", nowMillis() - begin);
+			if (startWorker())
+				how = WORKER;
+		}
+	}
+	else if (how == WORKER) {
+		queue.push_back(ticket);
+		ready.notify_all();
+	}
+	return ticket;
+}
+
+void ProgramBuilder::finish(Job& job) {
+	finishProgram(job.build);
+	if (!job.build.linked) {
+		glDeleteProgram(job.build.program);
+		job.build.program = 0;
+	}
+	job.done = true;
+}
+
+bool ProgramBuilder::poll(int ticket, GLuint& program) {
+	std::unique_lock<std::mutex> l(lock);
+	auto at = jobs.find(ticket);
+	if (at == jobs.end()) {
+		program = 0;
+		return true;
+	}
+	Job& job = at->second;
+
+	if (job.how == INLINE && !job.done) {
+		if (startProgram(job.vertex.c_str(), job.fragment.c_str(), job.defines.c_str(), job.build))
+			finish(job);
+		job.done = true;
+	}
+	else if (job.how == PARALLEL && !job.done) {
+		// Only the link's status says whether everything is through; asking for anything else would wait for it.
+		GLint complete = GL_TRUE;
+		if (job.build.vertexShader != 0)
+			glGetProgramiv(job.build.program, GL_COMPLETION_STATUS_KHR, &complete);
+		if (complete != GL_TRUE)
+			return false;
+		finish(job);
+	}
+	if (!job.done)
+		return false;
+
+	program = job.build.program;
+	jobs.erase(at);
+	return true;
+}
+
+GLuint ProgramBuilder::wait(int ticket) {
+	GLuint program = 0;
+	while (!poll(ticket, program))
+		std::this_thread::yield();
+	return program;
+}
+
+void ProgramBuilder::work() {
+	glfwMakeContextCurrent(context);
+
+	std::unique_lock<std::mutex> l(lock);
+	for (;;) {
+		ready.wait(l, [&]() { return stopping || !queue.empty(); });
+		if (stopping)
+			break;
+
+		// Jobs are only erased once done, so this one stays put while the lock is let go.
+		Job& job = jobs[queue.front()];
+		queue.pop_front();
+		job.started = true;
+		std::string vertex = job.vertex, fragment = job.fragment, defines = job.defines;
+		l.unlock();
+
+		ProgramBuild build;
+		if (startProgram(vertex.c_str(), fragment.c_str(), defines.c_str(), build)) {
+			finishProgram(build);
+			if (!build.linked) {
+				glDeleteProgram(build.program);
+				build.program = 0;
+			}
+		}
+		// The main context may only use the program once everything that made it has gone through.
+		glFinish();
+
+		l.lock();
+		job.build = build;
+		job.done = true;
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "Raymarching.h"
+#include <glad/glad.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct GLFWwindow;
+
+#define BUILDER_STALL 50.0 // ms
+
+/*
+ASYNC PROGRAM BUILDER:
+  Builds programs the way LoadShaders() does without the render loop waiting for them. start() hands out a ticket and
+  poll() says, once a frame, whether it's done. The caller keeps drawing with whatever it had until then.
+
+  How depends on what the driver offers, best first:
+    PARALLEL  KHR/ARB_parallel_shader_compile. The compiles and the link are issued right away and the driver runs them
+              on its own threads; poll() asks GL_COMPLETION_STATUS_KHR and only reads the logs once that's true.
+    WORKER    a hidden window whose context shares objects with the main one, made current on a thread of our own
+              that builds one job after another and glFinish()es before handing the program over.
+    INLINE    neither, no window to share with or it couldn't be made: the build runs inside poll(), like LoadShaders().
+  A program that comes out of the binary cache is done in all three as soon as it's loaded. Some drivers have the
+  extension and still compile inside glCompileShader (Mesa's llvmpipe does); when a build holds start() up for more
+  than BUILDER_STALL ms, the builder moves on to the worker if it can.
+
+  Every call must come from the thread that owns the main context.
+*/
+
+class ProgramBuilder {
+public:
+	enum Mode { PARALLEL, WORKER, INLINE };
+
+	// share is the window whose context the worker shares, if the driver has no parallel compile. NULL for none.
+	ProgramBuilder(GLFWwindow* share = NULL);
+	// Drops what hasn't started, waits for what has and deletes every program nobody polled for.
+	~ProgramBuilder();
+
+	// Queues vertex + fragment built with defines, as for LoadShaders(). Returns the ticket to poll with.
+	int start(const char* vertex, const char* fragment, const std::string& defines);
+	// True once the ticket is done, with program set to its program, 0 if it didn't build. The ticket is spent then.
+	bool poll(int ticket, GLuint& program);
+	// Polls until the ticket is done.
+	GLuint wait(int ticket);
+
+	Mode mode() const { return how; }
+	const char* modeName() const;
+
+private:
+	struct Job {
+		std::string vertex, fragment, defines;
+		ProgramBuild build;
+		Mode how = INLINE; // the builder's when the job was started
+		bool started = false, done = false;
+	};
+	bool startWorker();
+	void work();
+	void finish(Job& job);
+
+	Mode how = INLINE;
+	std::map<int, Job> jobs;
+	int next = 0;
+
+	GLFWwindow* share = NULL;
+	GLFWwindow* context = NULL; // the worker's
+	std::mutex lock;
+	std::condition_variable ready;
+	std::deque<int> queue; // tickets the worker hasn't started, in order
+	bool stopping = false;
+	std::thread worker;
+};
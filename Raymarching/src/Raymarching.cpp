@@ -1,17 +1,40 @@
 #include "Raymarching.h"
+#include "CpuRenderer.h"
+#include "Readback.h"
+#include "Extensions.h"
+#include "ShaderCache.h"
+#include "Uniforms.h"
+#include "Clock.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "InputRecord.h"
+#include "DynamicResolution.h"
+#include "TemporalCache.h"
+#include "ConePrepass.h"
+#include "BrickMap.h"
+#include "AmbientOcclusion.h"
+#include "ShadowCache.h"
+#include "DeferredShading.h"
+#include "LightBuffer.h"
+#include "SceneCompiler.h"
+#include "SceneInterpreter.h"
+#include "ProgramBuilder.h"
+#include "ShaderVariants.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <fstream>
 #include <vector>
 #include <sstream>
 #include <stdio.h>
-#include <windows.h>
+#include <stdlib.h>
 #include <glm/matrix.hpp>
 #include <iostream>
+#include <string.h>
 
 #define EXIT_FAIL() return -1
 #define EXIT_PASS() return 0
-#define ASSERT_PAUSE() if (pause != NULL) { epoch += (currentTimeMillis() - pause); pause = NULL; }
+#define NOT_PAUSED -1.0
+#define ASSERT_PAUSE() if (pause != NOT_PAUSED) { epoch += (nowMillis() - pause); pause = NOT_PAUSED; }
 
 #define SPEED 15.
 #define CAMX_SPEED 90.
@@ -35,17 +58,40 @@ CONTROLS:
 
   LCTRL: 2x move speed
   LALT: 0.25x move/look speed
+
+  F1-F4: quality tier (low, medium, high, ultra), see ShaderVariants.h
+
+  Saving screen.frag or screen.vert rebuilds the main pass in the background, see ShaderVariants.h, unless -cone, -ao,
+  -shadows or -bricks is on: their programs are built once and would go on marching the old sdf(). Without -deferred the
+  window comes up right away and the first frame is drawn once the screen program is built, see ProgramBuilder.h.
+
+COMMAND LINE:
+  Interactive options, any combination:
+    -profile [prefix]: write prefix.json (Chrome trace) and prefix.csv (min/median/p99) on exit.
+    -record <file>: log every frame's keys and dT to a compact binary file.
+    -replay <file>: drive input() and timeFlow() from a recording instead of the keyboard, stepping the clock by the recorded dTs.
+    -export <file.path>: write the camera path of the session in the -bench path format on exit.
+    -dynres [target ms]: render at a scaled resolution driven by the measured GPU time and upscale to the window (default 16.7 ms).
+    -temporal: reuse last frame's primary hits and accumulate color over frames, see TemporalCache.h.
+    -cone [tile]: cone-march a 1/tile resolution prepass and start every primary ray where its tile's cone hit (default 8).
+    -ao [scale]: compute the primary hits' occlusion once per scale x scale block, reuse it across frames and upsample it, see AmbientOcclusion.h (default 4).
+    -shadows [tile]: soft shadows from the lights that light each hit the most, with a per tile visibility cache, see ShadowCache.h (default 4, 0 for no cache).
+    -deferred: march the primary rays into a G-buffer first, then shade surfaces and sky in separate passes, see DeferredShading.h.
+    -bricks [voxel]: bake the mirrors and the icosahedron into a sparse distance field and march that, see BrickMap.h (default 0.03).
+    -lights N: scatter N small lights over the ground on top of the scene's three, see LightBuffer.h.
+    -scene <file>: march the shapes, materials and lights of a scene file instead of the built-in scene, see SceneCompiler.h.
+    -interpret: with -scene, interpret the scene from a buffer instead of compiling it, and reload the file when it's saved, see SceneInterpreter.h.
+    -relax [omega]: over-relaxed sphere tracing with a fallback to plain steps, see RELAXATION in screen.frag (default 1.6).
+    -quality <tier>: start at low, medium, high or ultra, see ShaderVariants.h (default high). The passes other than the main one keep it.
+    -D NAME[=VALUE]: override one of screen.frag's switches, e.g. -D NORMALS=2 or -D BOUNDS=0. Repeatable.
+  -cpu [out.ppm] [width] [height] [time] [normals]: render a single frame on the CPU and exit, normals as for -D NORMALS. No window or GL context is created.
+  -headless [frames] [width] [height] [profile prefix]: render screen.frag into an offscreen framebuffer for N frames and exit. No display is needed.
+  -bench [-o results.json] [-frames N] [-res WxH]... [-cone [tile]] [-ao [scale]] [-shadows [tile]] [-bricks [voxel]] [-deferred] [-lights N] [-scene file [-interpret]] [-relax [omega]] [-quality tier] [-D NAME[=VALUE]]... [-steps] [path files...]: replay camera paths headless and report fps, ms percentiles and Mpix/s.
+  -batch <first> <last> [width] [height] [step ms] [prefix]: render frames first..last headless with time = frame*step (fractional ms allowed) and write prefix00000.ppm...
 */
 
 /******||UTILS||******/
 
-__int64 currentTimeMillis() {
-	FILETIME f;
-	GetSystemTimeAsFileTime(&f);
-	(long long)f.dwHighDateTime;
-	__int64 nano = ((__int64)f.dwHighDateTime << 32LL) + (__int64)f.dwLowDateTime;
-	return (nano - 116444736000000000LL) / 10000;
-}
 inline double random_double() {
 	// Returns a random real in [0,1).
 	return rand() / (RAND_MAX + 1.0);
@@ -54,11 +100,10 @@ inline double random_double(double min, double max) {
 	// Returns a random real in [min,max).
 	return min + (max - min) * random_double();
 }
-GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path) {
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+bool startProgram(const char* vertex_file_path, const char* fragment_file_path, const char* defines, ProgramBuild& build) {
+	build = ProgramBuild();
+	build.vertexName = vertex_file_path;
+	build.fragmentName = fragment_file_path;
 
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
@@ -71,8 +116,7 @@ GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path)
 	}
 	else {
 		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
-		return 0;
+		return false;
 	}
 
 	// Read the Fragment Shader code from the file
@@ -85,66 +129,152 @@ GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path)
 		FragmentShaderStream.close();
 	}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
+	// A compiled scene rides along in the defines but calls into the shader, so it goes to the fragment shader's
+	// SCENE_MARKER line instead of the top.
+	std::string Defines = defines, SceneCode;
+	size_t SceneBegin = Defines.find(SCENE_BEGIN), SceneEnd = Defines.find(SCENE_END);
+	if (SceneBegin != std::string::npos && SceneEnd != std::string::npos) {
+		SceneCode = Defines.substr(SceneBegin + strlen(SCENE_BEGIN), SceneEnd - SceneBegin - strlen(SCENE_BEGIN));
+		Defines.erase(SceneBegin, SceneEnd + strlen(SCENE_END) - SceneBegin);
+
+		size_t marker = FragmentShaderCode.find(SCENE_MARKER);
+		if (marker == std::string::npos)
+			printf("%s has no '%s' line for the scene to go to\n", fragment_file_path, SCENE_MARKER);
+		else
+			FragmentShaderCode.replace(marker, strlen(SCENE_MARKER), SceneCode);
+	}
+	if (!Defines.empty()) {
+		size_t line = FragmentShaderCode.find('\n');
+		FragmentShaderCode.insert(line == std::string::npos ? FragmentShaderCode.size() : line + 1, Defines);
+	}
+
+	// Try the program binary cache before compiling anything
+	build.cacheKey = programCacheKey(VertexShaderCode, FragmentShaderCode);
+	build.program = loadCachedProgram(build.cacheKey);
+	if (build.program != 0) {
+		printf("Loaded cached program %s\n", build.cacheKey.c_str());
+		return true;
+	}
+
+	// Create the shaders
+	build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
 	char const* VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
-	glCompileShader(VertexShaderID);
+	glShaderSource(build.vertexShader, 1, &VertexSourcePointer, NULL);
+	glCompileShader(build.vertexShader);
+
+	// Compile Fragment Shader
+	printf("Compiling shader : %s\n", fragment_file_path);
+	char const* FragmentSourcePointer = FragmentShaderCode.c_str();
+	glShaderSource(build.fragmentShader, 1, &FragmentSourcePointer, NULL);
+	glCompileShader(build.fragmentShader);
+
+	// Link the program, its status and the logs are for finishProgram()
+	printf("Linking program\n");
+	build.program = glCreateProgram();
+	glAttachShader(build.program, build.vertexShader);
+	glAttachShader(build.program, build.fragmentShader);
+	if (GLEXT.programBinary)
+		GLEXT.ProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(build.program);
+	return true;
+}
+GLuint finishProgram(ProgramBuild& build) {
+	// From the binary cache, nothing to wait for
+	if (build.vertexShader == 0) {
+		build.linked = build.program != 0;
+		return build.program;
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
 
 	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(build.vertexShader, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if (InfoLogLength > 0) {
 		std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+		glGetShaderInfoLog(build.vertexShader, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
+		printf("%s: %s\n", build.vertexName.c_str(), &VertexShaderErrorMessage[0]);
 	}
 
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const* FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer, NULL);
-	glCompileShader(FragmentShaderID);
-
 	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetShaderiv(build.fragmentShader, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if (InfoLogLength > 0) {
 		std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+		glGetShaderInfoLog(build.fragmentShader, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+		printf("%s: %s\n", build.fragmentName.c_str(), &FragmentShaderErrorMessage[0]);
 	}
 
-	// Link the program
-	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
 	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	glGetProgramiv(build.program, GL_LINK_STATUS, &Result);
+	glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if (InfoLogLength > 0) {
 		std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		glGetProgramInfoLog(build.program, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
+	build.linked = Result == GL_TRUE;
+	if (build.linked)
+		storeCachedProgram(build.cacheKey, build.program);
 
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
+	glDetachShader(build.program, build.vertexShader);
+	glDetachShader(build.program, build.fragmentShader);
 
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	glDeleteShader(build.vertexShader);
+	glDeleteShader(build.fragmentShader);
+	build.vertexShader = build.fragmentShader = 0;
 
-	return ProgramID;
+	return build.program;
+}
+GLuint LoadShaders(const char* vertex_file_path, const char* fragment_file_path, const char* defines) {
+	ProgramBuild build;
+	if (!startProgram(vertex_file_path, fragment_file_path, defines, build))
+		return 0;
+	return finishProgram(build);
+}
+
+std::string defineLine(const char* arg) {
+	std::string line = std::string("#define ") + arg + "\n";
+	size_t eq = line.find('=');
+	if (eq != std::string::npos)
+		line[eq] = ' ';
+	return line;
+}
+bool takeNumber(int argc, char** argv, int& i) {
+	if (i + 1 >= argc || argv[i + 1][0] == '\0')
+		return false;
+	char* end;
+	strtod(argv[i + 1], &end);
+	if (*end != '\0')
+		return false;
+	i++;
+	return true;
+}
+std::string jsonEscape(const std::string& s) {
+	std::string out;
+	for (char c : s) {
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20) {
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", c);
+			out += code;
+		}
+		else
+			out += c;
+	}
+	return out;
 }
 
 /******||MAIN||******/
-int GLFW_INIT() {
+int GLFW_INIT(bool headless = false) {
+	// The null platform never talks to a display server, contexts come from OSMesa or EGL instead.
+	if (headless)
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+
 	if (!glfwInit())
 		EXIT_FAIL();
 
@@ -165,8 +295,31 @@ GLFWwindow* createWindow(int wid, int hei, const char* name) {
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
 		return NULL;
 	}
+	loadExtensions();
 	return win;
 }
+GLFWwindow* createHeadless(int wid, int hei) {
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	// Try OSMesa first since it needs nothing but the library, then fall back to a surfaceless EGL context.
+	const int apis[] = { GLFW_OSMESA_CONTEXT_API, GLFW_EGL_CONTEXT_API };
+	for (int api : apis) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+		GLFWwindow* win = glfwCreateWindow(wid, hei, "Ray Marching", NULL, NULL);
+		if (win == NULL)
+			continue;
+
+		glfwMakeContextCurrent(win);
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+			glfwDestroyWindow(win);
+			continue;
+		}
+		loadExtensions();
+		return win;
+	}
+	glfwTerminate();
+	return NULL;
+}
 void genVAsVBs(GLuint* VAID, GLuint* VB) {
 	static const float vertex_buffer_data[] = {
 		-1.0f, 1.0f,
@@ -183,10 +336,41 @@ void genVAsVBs(GLuint* VAID, GLuint* VB) {
 	glBindBuffer(GL_ARRAY_BUFFER, *VB);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
 }
+int genFramebuffer(GLuint* FBO, GLuint* color, int wid, int hei) {
+	glGenTextures(1, color);
+	glBindTexture(GL_TEXTURE_2D, *color);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, wid, hei, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, *FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *color, 0);
+	// Some surfaceless contexts start with GL_NONE here even for user framebuffers.
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Framebuffer %dx%d is incomplete\n", wid, hei);
+		EXIT_FAIL();
+	}
+	EXIT_PASS();
+}
+void drawScreen(GLuint vertexbuffer) {
+	// DRAWING THE SQUARE
+	glEnableVertexAttribArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	glDisableVertexAttribArray(0);
+}
 
 int scroll = 1;
-long long pause = NULL;
-auto epoch = currentTimeMillis();
+double pause = NOT_PAUSED;
+double epoch = nowMillis();
 
 // A X B = (a[1]b[2]-a[2]b[1])(x) + (a[2]b[0]-a[0]b[2])(y) + (a[0]b[1]-a[1]b[0])(z)
 
@@ -199,31 +383,35 @@ glm::vec3 ro = { 0.0f, 0.0f, -8.0f };
 glm::vec3 fwd = { 0.0f, 0.0f, 1.0f };
 glm::vec3 up = { 0.0f, 1.0f, 0.0f };
 
-int timeInput(GLFWwindow* window) {
-	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
+// Keys held this frame. Comes from GLFW, or from the file when replaying a recording.
+unsigned int frameKeys = 0;
+#define keyDown(key) keyInMask(frameKeys, key)
+
+int timeInput() {
+	if (keyDown(GLFW_KEY_2)) {
 		ASSERT_PAUSE();
 		return -2;
 	}
-	if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
+	if (keyDown(GLFW_KEY_3)) {
 		ASSERT_PAUSE();
 		return -1;
 	}
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS && pause == NULL) {
-		pause = currentTimeMillis();
+	if (keyDown(GLFW_KEY_E) && pause == NOT_PAUSED) {
+		pause = nowMillis();
 		return 0;
 	}
-	if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) {
+	if (keyDown(GLFW_KEY_4)) {
 		ASSERT_PAUSE();
 		return 1;
 	}
-	if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) {
+	if (keyDown(GLFW_KEY_5)) {
 		ASSERT_PAUSE();
 		return 2;
 	}
 	return scroll;
 }
-void timeFlow(GLFWwindow* window) {
-	scroll = timeInput(window);
+void timeFlow() {
+	scroll = timeInput();
 
 	switch (scroll) {
 		case -2:
@@ -240,19 +428,19 @@ void timeFlow(GLFWwindow* window) {
 			break;
 	}
 }
-void input(GLFWwindow* window, double dT) {
+void input(double dT) {
 	// CAMERA
 
 	float sp = SPEED * dT, cx = CAMX_SPEED * dT, cy = CAMY_SPEED * dT;
 
-	if (glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
+	if (keyDown(GLFW_KEY_LEFT_ALT)) {
 		sp *= 0.25;	
 	}
-	if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS) {
+	if (keyDown(GLFW_KEY_LEFT_CONTROL)) {
 		sp *= 2.;
 	}
 
-	if(glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+	if(keyDown(GLFW_KEY_UP)) {
 		pitch += cy;
 
 		if (pitch > 89.0f)
@@ -266,7 +454,7 @@ void input(GLFWwindow* window, double dT) {
 		fwd = normalize(fwd);
 		up = cross(fwd, normalize(cross(glm::vec3{ 0.0f,1.0f,0.0f }, fwd)));
 	} 
-	if(glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+	if(keyDown(GLFW_KEY_DOWN)) {
 		pitch -= cy;
 
 		if (pitch > 89.0f)
@@ -280,7 +468,7 @@ void input(GLFWwindow* window, double dT) {
 		fwd = normalize(fwd);
 		up = cross(fwd, normalize(cross(glm::vec3{ 0.0f,1.0f,0.0f }, fwd)));
 	}
-	if(glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+	if(keyDown(GLFW_KEY_RIGHT)) {
 		yaw -= cx;
 
 		fwd.x = cos(radians(yaw)) * cos(radians(pitch));
@@ -288,7 +476,7 @@ void input(GLFWwindow* window, double dT) {
 		fwd = normalize(fwd);
 		up = cross(fwd, normalize(cross(glm::vec3{ 0.0f,1.0f,0.0f }, fwd)));
 	}
-	if(glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+	if(keyDown(GLFW_KEY_LEFT)) {
 		yaw += cx;
 
 		fwd.x = cos(radians(yaw)) * cos(radians(pitch));
@@ -297,20 +485,307 @@ void input(GLFWwindow* window, double dT) {
 		up = cross(fwd, normalize(cross(glm::vec3{ 0.0f,1.0f,0.0f }, fwd)));
 	}
 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+	if (keyDown(GLFW_KEY_W))
 		ro += fwd * sp;
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+	if (keyDown(GLFW_KEY_S))
 		ro -= fwd * sp;
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	if (keyDown(GLFW_KEY_D))
 		ro += cross(up, fwd) * sp;
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	if (keyDown(GLFW_KEY_A))
 		ro -= cross(up, fwd) * sp;
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
+	if (keyDown(GLFW_KEY_SPACE))
 		ro += up * sp;
-	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+	if (keyDown(GLFW_KEY_LEFT_SHIFT))
 		ro -= up * sp;
 }
-int main() {
+int writePPM(const char* path, const unsigned char* rgba, int wid, int hei) {
+	FILE* f = fopen(path, "wb");
+	if (f == NULL) {
+		printf("Impossible to open %s for writing.\n", path);
+		return -1;
+	}
+	fprintf(f, "P6\n%d %d\n255\n", wid, hei);
+
+	// rgba is bottom row first like glReadPixels, PPM wants the top row first.
+	std::vector<unsigned char> row(size_t(wid) * 3);
+	for (int y = hei - 1; y >= 0; y--) {
+		const unsigned char* src = rgba + size_t(y) * wid * 4;
+		for (int x = 0; x < wid; x++) {
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		fwrite(row.data(), 1, row.size(), f);
+	}
+	fclose(f);
+	return 0;
+}
+int writePPM(const char* path, const std::vector<glm::vec3>& pixels, int wid, int hei) {
+	std::vector<unsigned char> rgba(pixels.size() * 4);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		glm::vec3 c = glm::clamp(pixels[i], 0.0f, 1.0f);
+		rgba[i * 4 + 0] = (unsigned char)(c.r * 255.0f + 0.5f);
+		rgba[i * 4 + 1] = (unsigned char)(c.g * 255.0f + 0.5f);
+		rgba[i * 4 + 2] = (unsigned char)(c.b * 255.0f + 0.5f);
+		rgba[i * 4 + 3] = 255;
+	}
+	return writePPM(path, rgba.data(), wid, hei);
+}
+int cpuMain(int argc, char** argv) {
+	const char* out = argc > 2 ? argv[2] : "frame.ppm";
+
+	FrameUniforms u;
+	u.res = glm::vec2(argc > 3 ? atoi(argv[3]) : 1080, argc > 4 ? atoi(argv[4]) : 720);
+	u.time = argc > 5 ? atof(argv[5]) : 0.0;
+	int normals = argc > 6 ? atoi(argv[6]) : 0;
+	u.seed = 0.0f;
+	u.cam = ro;
+	u.look = fwd;
+
+	std::vector<glm::vec3> pixels;
+	double start = nowMillis();
+	renderCPU(u, pixels, 0, normals);
+	printf("Rendered %dx%d on the CPU in %.1f ms\n", int(u.res.x), int(u.res.y), nowMillis() - start);
+
+	if (writePPM(out, pixels, int(u.res.x), int(u.res.y)) == -1)
+		EXIT_FAIL();
+	EXIT_PASS();
+}
+int initHeadless(int wid, int hei, GLuint* vertexbuffer, GLuint* FBO, GLuint* color, GLuint* screen, const char* defines) {
+	if (GLFW_INIT(true) == -1)
+		EXIT_FAIL();
+
+	GLFWwindow* window = createHeadless(wid, hei);
+	if (window == NULL) {
+		printf("Could not create a headless OSMesa or EGL context\n");
+		EXIT_FAIL();
+	}
+
+	GLuint VAID;
+	genVAsVBs(&VAID, vertexbuffer);
+
+	if (genFramebuffer(FBO, color, wid, hei) == -1)
+		EXIT_FAIL();
+	glViewport(0, 0, wid, hei);
+
+	*screen = LoadShaders("screen.vert", "screen.frag", defines);
+	glUseProgram(*screen);
+	EXIT_PASS();
+}
+void writeProfile(const FrameProfiler* profiler, const std::string& prefix) {
+	if (profiler->writeChromeTrace((prefix + ".json").c_str()) && profiler->writeSummaryCSV((prefix + ".csv").c_str()))
+		printf("Wrote %s.json and %s.csv\n", prefix.c_str(), prefix.c_str());
+}
+int headlessMain(int argc, char** argv) {
+	int frames = argc > 2 ? atoi(argv[2]) : 100;
+	int wid = argc > 3 ? atoi(argv[3]) : 1080, hei = argc > 4 ? atoi(argv[4]) : 720;
+	const char* profilePrefix = argc > 5 ? argv[5] : NULL;
+
+	unsigned int vertexbuffer, FBO, color, screen;
+	if (initHeadless(wid, hei, &vertexbuffer, &FBO, &color, &screen) == -1)
+		EXIT_FAIL();
+
+	UniformBinding* uniforms = new UniformBinding();
+	uniforms->attach(screen);
+	LightBuffer* lights = new LightBuffer();
+	lights->attach(screen, *uniforms);
+
+	FrameProfiler* profiler = profilePrefix != NULL ? new FrameProfiler() : NULL;
+
+	double start = nowMillis();
+	for (int frame = 0; frame < frames; frame++) {
+		if (profiler) profiler->beginFrame();
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		{
+			PROFILE_SCOPE(profiler, "uniforms");
+			double time = nowMillis() - epoch;
+			uniforms->upload({ glm::vec2(wid, hei), time, (float)random_double(0, 10000000), ro, fwd });
+			lights->update(time);
+		}
+		{
+			PROFILE_SCOPE(profiler, "draw");
+			if (profiler) profiler->beginGpu();
+			drawScreen(vertexbuffer);
+			if (profiler) profiler->endGpu();
+		}
+
+		if (profiler) profiler->endFrame();
+	}
+	glFinish();
+	double elapsed = nowMillis() - start;
+
+	printf("Rendered %d frames at %dx%d in %.1f ms (%.2f fps)\n", frames, wid, hei, elapsed, elapsed > 0 ? frames * 1000.0 / elapsed : 0.0);
+
+	if (profiler) {
+		// One more frame so the last queries get collected.
+		profiler->beginFrame();
+		profiler->endFrame();
+		writeProfile(profiler, profilePrefix);
+		delete profiler;
+	}
+
+	delete lights;
+	delete uniforms;
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteTextures(1, &color);
+	glfwTerminate();
+	EXIT_PASS();
+}
+int batchMain(int argc, char** argv) {
+	if (argc < 4) {
+		printf("usage: -batch <first> <last> [width] [height] [step ms] [prefix]\n");
+		EXIT_FAIL();
+	}
+	int first = atoi(argv[2]), last = atoi(argv[3]);
+	int wid = argc > 4 ? atoi(argv[4]) : 1080, hei = argc > 5 ? atoi(argv[5]) : 720;
+	double step = argc > 6 ? atof(argv[6]) : 16.0;
+	std::string prefix = argc > 7 ? argv[7] : "frame";
+
+	unsigned int vertexbuffer, FBO, color, screen;
+	if (initHeadless(wid, hei, &vertexbuffer, &FBO, &color, &screen) == -1)
+		EXIT_FAIL();
+
+	UniformBinding* uniforms = new UniformBinding();
+	uniforms->attach(screen);
+	LightBuffer* lights = new LightBuffer();
+	lights->attach(screen, *uniforms);
+
+	// Frames are mapped a few frames after they were drawn and written straight out of the mapped buffer on the readback thread.
+	int failed = 0;
+	char path[512];
+	ReadbackRing* readback = new ReadbackRing(wid, hei, [&](int frame, const unsigned char* rgba, int w, int h) {
+		if (rgba == NULL) {
+			printf("Frame %d couldn't be read back\n", frame);
+			failed++;
+			return;
+		}
+		snprintf(path, sizeof(path), "%s%05d.ppm", prefix.c_str(), frame);
+		if (writePPM(path, rgba, w, h) == -1)
+			failed++;
+	});
+
+	double start = nowMillis();
+	for (int frame = first; frame <= last; frame++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// time and seed come from the frame number only so reruns give identical images.
+		uniforms->upload({ glm::vec2(wid, hei), frame * step, float(frame), ro, fwd });
+		lights->update(frame * step);
+
+		drawScreen(vertexbuffer);
+
+		readback->capture(frame);
+		readback->poll();
+	}
+	delete readback; // flushes the remaining frames
+
+	double elapsed = nowMillis() - start;
+	int frames = last - first + 1;
+	printf("Wrote %d frames at %dx%d in %.1f ms (%.2f fps)\n", frames, wid, hei, elapsed, elapsed > 0 ? frames * 1000.0 / elapsed : 0.0);
+
+	delete lights;
+	delete uniforms;
+	glDeleteFramebuffers(1, &FBO);
+	glDeleteTextures(1, &color);
+	glfwTerminate();
+
+	if (failed > 0) {
+		printf("%d of the %d frames failed\n", failed, frames);
+		EXIT_FAIL();
+	}
+	EXIT_PASS();
+}
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "-cpu") == 0)
+		return cpuMain(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "-headless") == 0)
+		return headlessMain(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "-batch") == 0)
+		return batchMain(argc, argv);
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+		return benchMain(argc, argv);
+
+	const char* profilePrefix = NULL;
+	const char* recordPath = NULL;
+	const char* replayPath = NULL;
+	const char* exportPath = NULL;
+	double dynresTarget = 0.0;
+	bool temporalCache = false, deferredShading = false;
+	int coneTile = 0, aoScale = 0, shadowTile = -1, extraLights = 0;
+	float brickVoxel = 0.f;
+	const char* scenePath = NULL;
+	bool interpretScene = false;
+	int quality = QUALITY_DEFAULT;
+	std::string defines;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-profile") == 0)
+			profilePrefix = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "profile";
+		else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "-export") == 0 && i + 1 < argc)
+			exportPath = argv[++i];
+		else if (strcmp(argv[i], "-dynres") == 0)
+			dynresTarget = takeNumber(argc, argv, i) ? atof(argv[i]) : 16.7;
+		else if (strcmp(argv[i], "-temporal") == 0)
+			temporalCache = true;
+		else if (strcmp(argv[i], "-deferred") == 0)
+			deferredShading = true;
+		else if (strcmp(argv[i], "-cone") == 0)
+			coneTile = takeNumber(argc, argv, i) ? atoi(argv[i]) : CONE_TILE;
+		else if (strcmp(argv[i], "-ao") == 0)
+			aoScale = takeNumber(argc, argv, i) ? atoi(argv[i]) : AO_SCALE;
+		else if (strcmp(argv[i], "-shadows") == 0) {
+			shadowTile = takeNumber(argc, argv, i) ? atoi(argv[i]) : SHADOW_TILE;
+			defines += "#define SHADOWS 1\n";
+		}
+		else if (strcmp(argv[i], "-bricks") == 0) {
+			brickVoxel = takeNumber(argc, argv, i) ? float(atof(argv[i])) : BRICK_VOXEL;
+			defines += "#define BRICKS\n";
+		}
+		else if (strcmp(argv[i], "-lights") == 0 && i + 1 < argc)
+			extraLights = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+			scenePath = argv[++i];
+		else if (strcmp(argv[i], "-interpret") == 0)
+			interpretScene = true;
+		else if (strcmp(argv[i], "-relax") == 0)
+			defines += "#define RELAXATION " + std::to_string(takeNumber(argc, argv, i) ? atof(argv[i]) : 1.6) + "\n";
+		else if (strcmp(argv[i], "-quality") == 0 && i + 1 < argc) {
+			quality = qualityTier(argv[++i]);
+			if (quality == -1) {
+				printf("Unknown quality tier %s, it's low, medium, high or ultra\n", argv[i]);
+				EXIT_FAIL();
+			}
+		}
+		else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc)
+			defines += defineLine(argv[++i]);
+	}
+
+	// The interpreter takes the scene as it loads, the compiled one goes into the defines.
+	Scene source;
+	CompiledScene scene;
+	if (scenePath != NULL) {
+		if (interpretScene) {
+			if (!loadScene(scenePath, source))
+				EXIT_FAIL();
+			defines += SceneInterpreter::defines();
+			scene.lights = source.lights;
+		}
+		else if (!compileScene(scenePath, scene))
+			EXIT_FAIL();
+		else
+			defines += scene.defines;
+		if (brickVoxel > 0.f) {
+			printf("The brick map only bakes the built-in scene, ignoring -bricks\n");
+			brickVoxel = 0.f;
+		}
+	}
+
 	if (GLFW_INIT() == -1)
 		EXIT_FAIL();
 
@@ -331,58 +806,325 @@ int main() {
 
 	std::vector<int> resolution = { 0, 0 };
 
-	unsigned int screen = LoadShaders("screen.vert", "screen.frag");
+	// The screen program is the starting quality tier's variant. It builds while the loop below already runs, unless
+	// the deferred passes are built right away anyway. Every other program is built with that tier once.
+	ProgramBuilder* builder = new ProgramBuilder(window);
+	printf("Building programs on %s\n", builder->modeName());
+	ShaderVariants* variants = new ShaderVariants(*builder, "screen.vert", "screen.frag", defines);
+	unsigned int screen = 0;
+	if (deferredShading)
+		screen = variants->build(QUALITY[quality].defines);
+	else
+		variants->request(QUALITY[quality].defines);
+	defines = variants->defines(QUALITY[quality].defines);
 	glUseProgram(screen);
 
-	//auto launch = currentTimeMillis();
-	int time = 0;
+	UniformBinding* uniforms = new UniformBinding();
+	if (screen != 0)
+		uniforms->attach(screen);
+
+	// Dynamic resolution takes its GPU times from the profiler, so it needs one even when nothing gets exported.
+	FrameProfiler* profiler = (profilePrefix != NULL || dynresTarget > 0.0) ? new FrameProfiler() : NULL;
+	DynamicResolution* dynres = dynresTarget > 0.0 ? new DynamicResolution(dynresTarget) : NULL;
+	long long dynresSample = -1;
+
+	// Every program that runs screen.frag's main pass. The screen program goes last, the temporal cache returns to it.
+	std::vector<GLuint> passes;
+	DeferredShading* deferred = NULL;
+	if (deferredShading) {
+		deferred = new DeferredShading(*uniforms, defines.c_str());
+		passes = deferred->shaders();
+		passes.push_back(screen);
+	}
+
+	TemporalCache* temporal = NULL;
+	if (temporalCache) {
+		temporal = new TemporalCache(*uniforms);
+		temporal->staticMaterials(scene.statics);
+		for (GLuint pass : passes)
+			temporal->attach(pass, *uniforms);
+	}
+	ConePrepass* cone = NULL;
+	if (coneTile > 0) {
+		cone = new ConePrepass(*uniforms, coneTile, defines.c_str());
+		for (GLuint pass : passes)
+			cone->attach(pass, *uniforms);
+	}
+	AmbientOcclusion* ao = NULL;
+	if (aoScale > 0) {
+		ao = new AmbientOcclusion(*uniforms, aoScale, defines.c_str());
+		for (GLuint pass : passes)
+			ao->attach(pass, *uniforms);
+		if (cone)
+			cone->attach(ao->shader(), *uniforms);
+	}
+	ShadowCache* shadows = NULL;
+	if (shadowTile > 0) {
+		shadows = new ShadowCache(*uniforms, shadowTile, defines.c_str());
+		for (GLuint pass : passes)
+			shadows->attach(pass, *uniforms);
+		if (cone)
+			cone->attach(shadows->shader(), *uniforms);
+	}
+	BrickMap* bricks = NULL;
+	if (brickVoxel > 0.f) {
+		bricks = new BrickMap(*uniforms, vertexbuffer, brickVoxel, defines.c_str());
+		for (GLuint pass : passes)
+			bricks->attach(pass, *uniforms);
+		if (cone)
+			bricks->attach(cone->shader(), *uniforms);
+		if (ao)
+			bricks->attach(ao->shader(), *uniforms);
+		if (shadows)
+			bricks->attach(shadows->shader(), *uniforms);
+	}
+	LightBuffer* lights = new LightBuffer(extraLights, scenePath != NULL ? &scene.lights : NULL);
+	for (GLuint pass : passes)
+		lights->attach(pass, *uniforms);
+	if (shadows)
+		lights->attach(shadows->shader(), *uniforms);
+	SceneInterpreter* interpreter = NULL;
+	if (scenePath != NULL && interpretScene) {
+		interpreter = new SceneInterpreter(source, scenePath);
+		if (!interpreter->valid())
+			EXIT_FAIL();
+		for (GLuint pass : passes)
+			interpreter->attach(pass, *uniforms);
+		if (cone)
+			interpreter->attach(cone->shader(), *uniforms);
+		if (ao)
+			interpreter->attach(ao->shader(), *uniforms);
+		if (shadows)
+			interpreter->attach(shadows->shader(), *uniforms);
+	}
+
+	// QUALITY TIERS: the rest build in the background from the first frame on, and a tier switched to before it's
+	// ready takes over the forward pass once it is, as does a tier rebuilt after screen.frag was saved. The deferred
+	// passes stay at the starting tier.
+	auto attachScreen = [&](GLuint program) {
+		uniforms->attach(program);
+		if (temporal)
+			temporal->attach(program, *uniforms);
+		if (cone)
+			cone->attach(program, *uniforms);
+		if (ao)
+			ao->attach(program, *uniforms);
+		if (shadows)
+			shadows->attach(program, *uniforms);
+		if (bricks)
+			bricks->attach(program, *uniforms);
+		lights->attach(program, *uniforms);
+		if (interpreter)
+			interpreter->attach(program, *uniforms);
+	};
+	// The other passes' programs are built once, a rebuilt main pass would march a different scene than they do.
+	if (cone || ao || shadows || bricks) {
+		variants->watch(false);
+		printf("The cone, AO, shadow and brick passes don't reload, neither does screen.frag while one of them is on\n");
+	}
+	int nextQuality = quality;
+	if (!deferred)
+		for (int i = 0; i < QUALITY_TIERS; i++)
+			variants->request(QUALITY[i].defines);
+
+	double time = 0.0;
+
+	// RECORD / REPLAY
+	FixedStepClock replayClock(0);
+	InputReplay replay;
+	InputRecorder recorder;
+	CameraPath exported;
+
+	if (replayPath != NULL) {
+		InputSession start;
+		if (!replay.open(replayPath, start))
+			EXIT_FAIL();
+
+		setClock(&replayClock);
+		ro = start.ro;
+		fwd = start.fwd;
+		up = start.up;
+		pitch = start.pitch;
+		yaw = start.yaw;
+		scroll = start.scroll;
+		pause = NOT_PAUSED;
+		epoch = nowMillis() - start.time;
+		time = start.time;
+	}
+	if (recordPath != NULL && !recorder.open(recordPath, { ro, fwd, up, pitch, yaw, scroll, nowMillis() - epoch }))
+		EXIT_FAIL();
 
 	// MAIN LOOP
-	long long last = currentTimeMillis();
+	long long last = nowNanos();
 	double dT;
 	do {
+		// Nothing to draw with until the first screen program is built, but the window keeps answering.
+		if (screen == 0) {
+			variants->update();
+			screen = variants->find(QUALITY[quality].defines);
+			if (variants->failed(QUALITY[quality].defines)) {
+				printf("screen.frag didn't build, nothing to draw\n");
+				break;
+			}
+			if (screen == 0) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glfwSwapBuffers(window);
+				glfwPollEvents();
+				last = nowNanos();
+				continue;
+			}
+			attachScreen(screen);
+			passes.push_back(screen);
+			glUseProgram(screen);
+		}
+
+		if (replayPath != NULL) {
+			long long step;
+			if (!replay.next(frameKeys, step))
+				break;
+			replayClock.setStep(step);
+		}
+
 		// deltaTime calculations.
-		auto cur = currentTimeMillis();
-		dT = 0.001 * (cur - last);
+		tickClock();
+		long long cur = nowNanos();
+		dT = 1e-9 * (cur - last);
+
+		if (replayPath == NULL)
+			frameKeys = pollKeys(window);
+		recorder.record(frameKeys, cur - last);
 		last = cur;
+
+		if (profiler) profiler->beginFrame();
 		
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
 		// INPUT SECTION
-		input(window, dT);
-		//std::cout << "(" << ro.x << ", " << ro.y << ", " << ro.z << ") " << dT;
-		//system("cls");
+		{
+			PROFILE_SCOPE(profiler, "input");
+			input(dT);
+		}
+
+		// QUALITY
+		if (!deferred) {
+			PROFILE_SCOPE(profiler, "variants");
+			for (int i = 0; i < QUALITY_TIERS; i++)
+				if (keyDown(GLFW_KEY_F1 + i) && i != nextQuality) {
+					nextQuality = i;
+					variants->request(QUALITY[i].defines);
+				}
+			variants->update();
+
+			// The old program keeps drawing until the new one is done.
+			GLuint next = variants->find(QUALITY[nextQuality].defines);
+			if (next != 0 && next != screen) {
+				attachScreen(next);
+				passes.back() = screen = next;
+				glUseProgram(screen);
+				if (nextQuality != quality)
+					printf("Quality: %s\n", QUALITY[nextQuality].name);
+				quality = nextQuality;
+			}
+			else if (nextQuality != quality && variants->failed(QUALITY[nextQuality].defines)) {
+				printf("Quality %s didn't build, staying at %s\n", QUALITY[nextQuality].name, QUALITY[quality].name);
+				nextQuality = quality;
+			}
+		}
  
 		// TIME MANIPULATION (???)
-		timeFlow(window); // changes the 'epoch' which is the time my program thinks it started. if you add/subtract small amounts repeatedly, it simulates the motion through time.
-		if(scroll != 0) time = int(currentTimeMillis() - epoch);
+		{
+			PROFILE_SCOPE(profiler, "timeFlow");
+			timeFlow(); // changes the 'epoch' which is the time my program thinks it started. if you add/subtract small amounts repeatedly, it simulates the motion through time.
+			if(scroll != 0) time = nowMillis() - epoch;
+		}
 
 		// UNIFORMS
+		glm::ivec2 size;
+		FrameUniforms u;
+		{
+			PROFILE_SCOPE(profiler, "uniforms");
+			glfwGetWindowSize(window, &resolution[0], &resolution[1]); // GET RESOLUTION
+			size = glm::ivec2(resolution[0], resolution[1]);
+			if (dynres)
+				size = dynres->begin(resolution[0], resolution[1]);
+			else
+				glViewport(0, 0, resolution[0], resolution[1]);
 
-		glfwGetWindowSize(window, &resolution[0], &resolution[1]); // GET RESOLUTION
-		glViewport(0, 0, resolution[0], resolution[1]);
-		glUniform2f(glGetUniformLocation(screen, "res"), resolution[0], resolution[1]); // PUSH RESOLUTION
+			u = { glm::vec2(size), time, (float)random_double(0, 10000000), ro, fwd };
+			if (temporal)
+				temporal->begin(u);
+			uniforms->upload(u);
+			lights->update(time);
+			if (interpreter)
+				interpreter->update(time);
+			if (interpreter && temporal)
+				temporal->staticMaterials(interpreter->staticMaterials());
+		}
+		if (exportPath != NULL)
+			exported.keys.push_back({ time, ro, fwd, up });
 
-		glUniform1i(glGetUniformLocation(screen, "time"), time); // PUSH TIME
+		{
+			PROFILE_SCOPE(profiler, "draw");
+			if (profiler) profiler->beginGpu();
+			if (cone)
+				cone->render(size, vertexbuffer);
+			if (ao)
+				ao->render(u, vertexbuffer);
+			if (shadows)
+				shadows->render(size, vertexbuffer);
+			if (temporal)
+				temporal->reproject();
+			if (deferred)
+				deferred->render(size, vertexbuffer);
+			else
+				drawScreen(vertexbuffer);
+			if (temporal)
+				temporal->end();
+			if (profiler) profiler->endGpu();
+		}
 
-		glUniform1f(glGetUniformLocation(screen, "seed"), (float)random_double(0, 10000000)); // PUSH RANDOM SEED
+		if (dynres) {
+			PROFILE_SCOPE(profiler, "upscale");
+			dynres->end();
 
-		glUniform3f(glGetUniformLocation(screen, "cam"), ro[0], ro[1], ro[2]); // PUSH CAMERA
+			// Only react to each GPU measurement once.
+			if (profiler->lastGpuFrame() != dynresSample) {
+				dynresSample = profiler->lastGpuFrame();
+				dynres->update(profiler->lastGpuMs());
+			}
+		}
 
-		glUniform3f(glGetUniformLocation(screen, "look"), fwd[0], fwd[1], fwd[2]); // PUSH LOOK
-		
-		// DRAWING THE SQUARE
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glDisableVertexAttribArray(0);
+		{
+			PROFILE_SCOPE(profiler, "swap");
+			glfwSwapBuffers(window);
+			glfwPollEvents();
+		}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		if (profiler) profiler->endFrame();
 	} while( (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS) && (glfwWindowShouldClose(window) == 0) );
 
+	delete variants;
+	delete builder;
+	delete interpreter;
+	delete lights;
+	delete bricks;
+	delete shadows;
+	delete ao;
+	delete cone;
+	delete deferred;
+	delete temporal;
+	delete dynres;
+	if (profiler) {
+		if (profilePrefix != NULL)
+			writeProfile(profiler, profilePrefix);
+		delete profiler;
+	}
+	if (exportPath != NULL && saveCameraPath(exportPath, exported))
+		printf("Wrote %s (%d frames)\n", exportPath, (int)exported.keys.size());
+	recorder.close();
+	setClock(NULL);
+
+	delete uniforms;
 	glfwTerminate();
 	EXIT_PASS();
 }
\ No newline at end of file
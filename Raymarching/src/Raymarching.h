@@ -0,0 +1,46 @@
+#pragma once
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <string>
+
+// Everything screen.frag reads from its uniforms for one frame.
+struct FrameUniforms {
+	glm::vec2 res;
+	double time; // milliseconds, fractional part included
+	float seed;
+
+	glm::vec3 cam;
+	glm::vec3 look;
+
+	// Only set by TemporalCache. temporal is 0 when there's no history to reproject.
+	glm::vec3 prevCam = glm::vec3(0.0f);
+	glm::vec3 prevLook = glm::vec3(0.0f, 0.0f, 1.0f);
+	float temporal = 0.0f;
+	float frame = 0.0f;
+};
+
+// Shared by the offline modes. Defined in Raymarching.cpp.
+// defines is inserted right after the fragment shader's #version line.
+unsigned int LoadShaders(const char* vertex_file_path, const char* fragment_file_path, const char* defines = "");
+// LoadShaders() in two halves, for builds that shouldn't wait on the driver. startProgram() prepares the sources the
+// same way and, unless the binary cache has the program, issues the compiles and the link without asking how they went.
+// finishProgram() asks, prints the logs, caches the binary and sets linked. False from startProgram() if a file is missing.
+struct ProgramBuild {
+	std::string vertexName, fragmentName, cacheKey;
+	unsigned int program = 0, vertexShader = 0, fragmentShader = 0; // no shaders when it came from the cache
+	bool linked = false;
+};
+bool startProgram(const char* vertex_file_path, const char* fragment_file_path, const char* defines, ProgramBuild& build);
+unsigned int finishProgram(ProgramBuild& build);
+// -D NAME or -D NAME=VALUE from the command line as a line of defines for LoadShaders.
+std::string defineLine(const char* arg);
+// For options with an optional number, in every mode: true, with i moved onto it, if the argument after argv[i] is a
+// number. Anything else is the next option, or a path file of -bench.
+bool takeNumber(int argc, char** argv, int& i);
+// s escaped for the inside of a JSON string.
+std::string jsonEscape(const std::string& s);
+// Headless context, fullscreen quad, a wid x hei framebuffer bound for drawing and screen.frag (built with defines) in use.
+int initHeadless(int wid, int hei, unsigned int* vertexbuffer, unsigned int* FBO, unsigned int* color, unsigned int* screen, const char* defines = "");
+void drawScreen(unsigned int vertexbuffer);
+// RGBA8 texture with linear filtering attached to a new framebuffer, left bound. -1 if incomplete.
+int genFramebuffer(unsigned int* FBO, unsigned int* color, int wid, int hei);
@@ -0,0 +1,137 @@
+#include "Readback.h"
+
+ReadbackRing::ReadbackRing(int wid, int hei, ReadbackConsumer consumer, int slots)
+	: wid(wid), hei(hei), frameBytes(size_t(wid) * hei * 4), consumer(consumer), slots(slots < 2 ? 2 : slots) {
+	for (Slot& s : this->slots) {
+		glGenBuffers(1, &s.PBO);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.PBO);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	worker = std::thread(&ReadbackRing::consume, this);
+}
+ReadbackRing::~ReadbackRing() {
+	flush();
+	{
+		std::unique_lock<std::mutex> l(lock);
+		done = true;
+	}
+	ready.notify_all();
+	worker.join();
+
+	for (Slot& s : slots)
+		glDeleteBuffers(1, &s.PBO);
+}
+
+void ReadbackRing::capture(int frame) {
+	std::unique_lock<std::mutex> l(lock);
+
+	// 'next' is always the oldest slot in the ring, so waiting on it never waits on a newer frame.
+	Slot& s = slots[next];
+	for (;;) {
+		pollLocked(false);
+		if (s.state == FREE)
+			break;
+		if (s.state == PENDING)
+			pollLocked(true);
+		else
+			ready.wait(l, [&]() { return s.state == CONSUMED; });
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, s.PBO);
+	glReadPixels(0, 0, wid, hei, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	s.frame = frame;
+	s.state = PENDING;
+
+	next = (next + 1) % int(slots.size());
+}
+
+void ReadbackRing::poll() {
+	std::unique_lock<std::mutex> l(lock);
+	pollLocked(false);
+}
+
+void ReadbackRing::flush() {
+	std::unique_lock<std::mutex> l(lock);
+	for (;;) {
+		pollLocked(false);
+
+		bool pending = false, mapped = false;
+		for (const Slot& s : slots) {
+			pending |= s.state == PENDING;
+			mapped |= s.state == MAPPED;
+		}
+		if (pending)
+			pollLocked(true);
+		else if (mapped)
+			ready.wait(l);
+		else
+			break;
+	}
+}
+
+void ReadbackRing::pollLocked(bool wait) {
+	int count = int(slots.size());
+	for (int i = 0; i < count; i++) {
+		Slot& s = slots[(next + i) % count];
+
+		if (s.state == CONSUMED) {
+			if (s.data != NULL) {
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, s.PBO);
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			s.data = NULL;
+			s.state = FREE;
+		}
+		else if (s.state == PENDING) {
+			// Only the oldest pending slot is ever waited on; newer ones can't finish before it.
+			GLuint64 timeout = wait ? 1000000000ull : 0;
+			GLenum status = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+			if (status == GL_TIMEOUT_EXPIRED)
+				break;
+			wait = false;
+
+			glDeleteSync(s.fence);
+			s.fence = NULL;
+
+			// A failed wait will never signal; the frame goes to the consumer without pixels instead of blocking the ring.
+			if (status == GL_WAIT_FAILED)
+				s.data = NULL;
+			else {
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, s.PBO);
+				s.data = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+			}
+			s.state = MAPPED;
+
+			mapped.push_back((next + i) % count);
+			ready.notify_all();
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void ReadbackRing::consume() {
+	std::unique_lock<std::mutex> l(lock);
+	for (;;) {
+		ready.wait(l, [&]() { return done || !mapped.empty(); });
+		if (mapped.empty())
+			return;
+
+		Slot& s = slots[mapped.front()];
+		mapped.pop_front();
+
+		int frame = s.frame;
+		const unsigned char* data = s.data;
+		l.unlock();
+
+		consumer(frame, data, wid, hei);
+
+		l.lock();
+		s.state = CONSUMED;
+		ready.notify_all();
+	}
+}
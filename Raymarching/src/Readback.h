@@ -0,0 +1,62 @@
+#pragma once
+#include <glad/glad.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+ASYNC READBACK:
+  A ring of pixel pack buffers. capture() starts a glReadPixels into the next free buffer and drops a fence behind it,
+  poll() maps the buffers whose fence has signalled and hands the mapped pointer to a consumer thread. Nothing is copied;
+  the buffer goes back into the ring once the consumer returns and the GL thread unmaps it.
+
+  Every call except the consumer itself must come from the thread that owns the GL context.
+*/
+
+#define READBACK_SLOTS 4
+
+// Called on the consumer thread. rgba is bottom row first and only valid until the callback returns, NULL for a frame
+// that couldn't be read back: its fence failed or its buffer didn't map.
+typedef std::function<void(int frame, const unsigned char* rgba, int wid, int hei)> ReadbackConsumer;
+
+class ReadbackRing {
+public:
+	ReadbackRing(int wid, int hei, ReadbackConsumer consumer, int slots = READBACK_SLOTS);
+	~ReadbackRing();
+
+	// Reads the bound read framebuffer. Blocks only if every slot is still in flight.
+	void capture(int frame);
+	// Maps finished slots, recycles consumed ones. Cheap, call once per frame.
+	void poll();
+	// Waits until every captured frame has been consumed.
+	void flush();
+
+private:
+	enum SlotState { FREE, PENDING, MAPPED, CONSUMED };
+	struct Slot {
+		GLuint PBO = 0;
+		GLsync fence = NULL;
+		int frame = 0;
+		SlotState state = FREE;
+		const unsigned char* data = NULL;
+	};
+
+	void pollLocked(bool wait);
+	void consume();
+
+	int wid, hei;
+	size_t frameBytes;
+	ReadbackConsumer consumer;
+
+	std::vector<Slot> slots;
+	int next = 0;
+
+	std::mutex lock;
+	std::condition_variable ready;
+	std::deque<int> mapped; // slot indices waiting for the consumer, in frame order
+	bool done = false;
+	std::thread worker;
+};
@@ -0,0 +1,666 @@
+#include "SceneCompiler.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <ctype.h>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAU 6.283185307179586
+#define FOLD_ANGLE 1e-5 // radians, a rotation closer than this to a whole turn is none
+
+#define LIGHT_RADIUS 160.f // like the built-in scene's
+
+struct SceneToken {
+	std::string text;
+	int line;
+};
+
+// How many of each a shape takes, in this order: axes, sizes, curves, then braces.
+struct ShapeKind {
+	const char* name;
+	int axes, sizes, curves;
+	bool group;
+};
+static const ShapeKind shapeKinds[] = {
+	{ "sphere", 0, 1, 0, false },
+	{ "box", 0, 3, 0, false },
+	{ "torus", 0, 2, 0, false },
+	{ "slab", 1, 2, 0, false },
+	{ "icosahedron", 0, 0, 0, false },
+	{ "union", 0, 0, 0, true },
+	{ "intersect", 0, 0, 0, true },
+	{ "subtract", 0, 0, 0, true },
+	{ "smooth", 0, 0, 1, true },
+	{ "morph", 0, 0, 1, true },
+	{ "translate", 0, 0, 3, true },
+	{ "rotate", 2, 0, 1, true },
+	{ "mirror", -1, 0, 0, true }, // one to three
+	{ "scale", 0, 0, 1, true },
+	{ "shrink", 0, 0, 1, true },
+	{ "bound", 0, 4, 0, true },
+};
+static const ShapeKind* shapeKind(const std::string& name) {
+	for (const ShapeKind& k : shapeKinds)
+		if (name == k.name)
+			return &k;
+	return NULL;
+}
+
+bool SceneShape::primitive() const {
+	const ShapeKind* kind = shapeKind(op);
+	return kind != NULL && !kind->group;
+}
+
+float SceneCurve::at(double time) const {
+	float t = float(time);
+	switch (type) {
+	case LINEAR:
+		return a * t + b;
+	case SINE:
+		return d + a * std::sin(b * t + c);
+	case SMOOTHSINE: {
+		float x = glm::clamp((std::sin(c * t) - a) / (b - a), 0.f, 1.f);
+		return x * x * (3.f - 2.f * x);
+	}
+	default:
+		return a;
+	}
+}
+
+/******||PARSING||******/
+
+static bool tokenize(const char* path, std::vector<SceneToken>& tokens) {
+	std::ifstream in(path);
+	if (!in.is_open()) {
+		printf("Impossible to open %s.\n", path);
+		return false;
+	}
+
+	std::string line;
+	for (int number = 1; std::getline(in, line); number++) {
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.resize(comment);
+
+		// Braces are tokens of their own, and a curve's parentheses keep it in one token whatever spaces it has.
+		std::string token;
+		int depth = 0;
+		for (char ch : line) {
+			depth += ch == '(' ? 1 : ch == ')' ? -1 : 0;
+			if (depth == 0 && (isspace((unsigned char)ch) || ch == '{' || ch == '}')) {
+				if (!token.empty())
+					tokens.push_back({ token, number });
+				token.clear();
+				if (ch == '{' || ch == '}')
+					tokens.push_back({ std::string(1, ch), number });
+			}
+			else if (!isspace((unsigned char)ch))
+				token += ch;
+		}
+		if (!token.empty())
+			tokens.push_back({ token, number });
+	}
+	return true;
+}
+
+static bool parseFloat(const std::string& text, float& value) {
+	char* end;
+	value = strtof(text.c_str(), &end);
+	return !text.empty() && *end == '\0';
+}
+
+static bool parseCurve(const std::string& text, SceneCurve& curve) {
+	curve = SceneCurve();
+	if (parseFloat(text, curve.a))
+		return true;
+
+	size_t open = text.find('(');
+	if (open == std::string::npos || text.back() != ')')
+		return false;
+	std::string name = text.substr(0, open), list = text.substr(open + 1, text.size() - open - 2);
+
+	std::vector<float> args;
+	for (size_t start = 0; start <= list.size();) {
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos)
+			comma = list.size();
+		float value;
+		if (!parseFloat(list.substr(start, comma - start), value))
+			return false;
+		args.push_back(value);
+		start = comma + 1;
+	}
+	args.resize(4, 0.f);
+
+	size_t given = std::count(list.begin(), list.end(), ',') + 1;
+	if (name == "lin" && given <= 2)
+		curve.type = SceneCurve::LINEAR;
+	else if (name == "sin" && given >= 2 && given <= 4)
+		curve.type = SceneCurve::SINE;
+	else if (name == "smoothsin" && given == 3)
+		curve.type = SceneCurve::SMOOTHSINE;
+	else
+		return false;
+	curve.a = args[0];
+	curve.b = args[1];
+	curve.c = args[2];
+	curve.d = args[3];
+	return true;
+}
+
+struct SceneParser {
+	const char* path;
+	std::vector<SceneToken> tokens;
+	size_t at = 0;
+	std::vector<SceneMaterial> materials;
+	std::vector<LightSource> lights;
+
+	bool done() const { return at >= tokens.size(); }
+	const std::string& peek() const {
+		static const std::string end;
+		return done() ? end : tokens[at].text;
+	}
+	int line() const { return tokens.empty() ? 0 : tokens[done() ? tokens.size() - 1 : at].line; }
+	bool error(const std::string& what) {
+		printf("%s:%d: %s\n", path, line(), what.c_str());
+		return false;
+	}
+
+	bool number(float& value) {
+		if (done() || !parseFloat(peek(), value))
+			return error("expected a number, not '" + peek() + "'");
+		at++;
+		return true;
+	}
+	bool curve(SceneCurve& value) {
+		if (done() || !parseCurve(peek(), value))
+			return error("expected a number or a curve, not '" + peek() + "'");
+		at++;
+		return true;
+	}
+
+	bool material() {
+		SceneMaterial m;
+		if (done())
+			return error("expected a material name");
+		m.name = tokens[at++].text;
+		if (!number(m.albedo.r) || !number(m.albedo.g) || !number(m.albedo.b))
+			return false;
+		m.albedo.a = 0.f;
+		for (;;) {
+			const std::string& option = peek();
+			float* value = option == "emissive" ? &m.albedo.a : option == "rough" ? &m.rough : option == "metal" ? &m.metal : option == "iref" ? &m.iref : NULL;
+			if (option == "checker") {
+				m.checker = true;
+				at++;
+			}
+			else if (value == NULL)
+				break;
+			else {
+				at++;
+				if (!number(*value))
+					return false;
+			}
+		}
+		materials.push_back(m);
+		return true;
+	}
+
+	bool light() {
+		LightSource l = { { glm::vec3(0.f), LIGHT_RADIUS, glm::vec4(1.f) }, 0.f };
+		if (!number(l.light.pos.x) || !number(l.light.pos.y) || !number(l.light.pos.z))
+			return false;
+		if (!number(l.light.col.r) || !number(l.light.col.g) || !number(l.light.col.b))
+			return false;
+		for (;;) {
+			const std::string& option = peek();
+			float* value = option == "strength" ? &l.light.col.a : option == "radius" ? &l.light.radius : option == "spin" ? &l.spin : NULL;
+			if (value == NULL)
+				break;
+			at++;
+			if (!number(*value))
+				return false;
+		}
+		lights.push_back(l);
+		return true;
+	}
+
+	bool shape(SceneShape& s) {
+		if (peek() == "off") {
+			s.off = true;
+			at++;
+		}
+		s.line = line();
+		const ShapeKind* kind = shapeKind(peek());
+		if (kind == NULL)
+			return error("expected a shape, not '" + peek() + "'");
+		s.op = tokens[at++].text;
+
+		if (kind->axes != 0) {
+			s.axes = peek();
+			bool valid = !s.axes.empty() && s.axes.size() <= 3 && (kind->axes < 0 || int(s.axes.size()) == kind->axes);
+			for (size_t i = 0; i < s.axes.size(); i++)
+				valid = valid && strchr("xyz", s.axes[i]) != NULL && s.axes.find(s.axes[i]) == i;
+			if (!valid)
+				return error(s.op + " wants " + (kind->axes == 1 ? "an axis" : kind->axes == 2 ? "a plane like xz" : "axes like xz") + ", not '" + peek() + "'");
+			at++;
+		}
+		s.sizes.resize(kind->sizes);
+		for (float& size : s.sizes)
+			if (!number(size))
+				return false;
+		s.args.resize(kind->curves);
+		for (SceneCurve& arg : s.args)
+			if (!curve(arg))
+				return false;
+
+		if (!kind->group) {
+			if (materials.empty())
+				return error("a shape needs a material declared before it");
+			for (;;) {
+				if (peek() == "mat") {
+					at++;
+					s.mat = -1;
+					for (size_t i = 0; i < materials.size(); i++)
+						if (materials[i].name == peek())
+							s.mat = int(i);
+					if (s.mat == -1)
+						return error("no material '" + peek() + "' declared before this");
+					at++;
+				}
+				else if (peek() == "round" && s.op == "box") {
+					at++;
+					if (!number(s.round))
+						return false;
+				}
+				else
+					break;
+			}
+			return true;
+		}
+
+		if (peek() != "{")
+			return error(s.op + " wants its shapes in braces");
+		at++;
+		while (peek() != "}") {
+			if (done())
+				return error("missing } for the " + s.op + " on line " + std::to_string(s.line));
+			s.children.push_back(SceneShape());
+			if (!shape(s.children.back()))
+				return false;
+		}
+		at++;
+
+		if (s.op == "morph" && s.children.size() != 2)
+			return error("morph wants exactly two shapes");
+		return true;
+	}
+
+	bool parse(SceneShape& root) {
+		root.op = "union";
+		while (!done()) {
+			if (peek() == "material") {
+				at++;
+				if (!material())
+					return false;
+			}
+			else if (peek() == "light") {
+				at++;
+				if (!light())
+					return false;
+			}
+			else {
+				root.children.push_back(SceneShape());
+				if (!shape(root.children.back()))
+					return false;
+			}
+		}
+		return true;
+	}
+};
+
+/******||FOLDING||******/
+
+static void foldCurve(SceneCurve& c, int& folded) {
+	if ((c.type == SceneCurve::LINEAR && c.a == 0.f) || (c.type == SceneCurve::SINE && c.a == 0.f)) {
+		c.a = c.type == SceneCurve::LINEAR ? c.b : c.d;
+		c.type = SceneCurve::CONSTANT;
+		folded++;
+	}
+}
+
+// Replaces s with its only child.
+static void collapse(SceneShape& s, int& folded) {
+	SceneShape only = std::move(s.children[0]);
+	s = std::move(only);
+	folded++;
+}
+
+// False if s comes out as nothing at all.
+static bool simplify(SceneShape& s, int& folded) {
+	if (s.off) {
+		folded++;
+		return false;
+	}
+	for (SceneCurve& c : s.args)
+		foldCurve(c, folded);
+	if (s.primitive())
+		return true;
+
+	std::vector<SceneShape> kept;
+	for (size_t i = 0; i < s.children.size(); i++) {
+		if (simplify(s.children[i], folded))
+			kept.push_back(std::move(s.children[i]));
+		else if (i == 0 && s.op == "subtract") { // nothing left to cut from
+			folded++;
+			return false;
+		}
+	}
+	s.children = std::move(kept);
+	if (s.children.empty()) {
+		folded++;
+		return false;
+	}
+
+	if (s.op == "morph") {
+		if (s.children.size() < 2)
+			s.op = "union";
+		else if (s.args[0].constant() && (s.args[0].a <= 0.f || s.args[0].a >= 1.f)) {
+			s.children.erase(s.children.begin() + (s.args[0].a <= 0.f ? 1 : 0));
+			s.op = "union";
+		}
+	}
+	else if (s.op == "translate" && s.args[0].constant() && s.args[1].constant() && s.args[2].constant()) {
+		SceneShape* inner = s.children.size() == 1 && s.children[0].op == "translate" ? &s.children[0] : NULL;
+		if (inner && inner->args[0].constant() && inner->args[1].constant() && inner->args[2].constant()) {
+			for (int i = 0; i < 3; i++)
+				s.args[i].a += inner->args[i].a;
+			std::vector<SceneShape> grandchildren = std::move(inner->children);
+			s.children = std::move(grandchildren);
+			folded++;
+		}
+		if (s.args[0].a == 0.f && s.args[1].a == 0.f && s.args[2].a == 0.f)
+			s.op = "union";
+	}
+	else if (s.op == "rotate" && s.args[0].constant()) {
+		SceneShape* inner = s.children.size() == 1 && s.children[0].op == "rotate" ? &s.children[0] : NULL;
+		if (inner && inner->axes == s.axes && inner->args[0].constant()) {
+			s.args[0].a += inner->args[0].a;
+			std::vector<SceneShape> grandchildren = std::move(inner->children);
+			s.children = std::move(grandchildren);
+			folded++;
+		}
+		if (std::abs(std::remainder(double(s.args[0].a), TAU)) < FOLD_ANGLE)
+			s.op = "union";
+	}
+	else if ((s.op == "scale" || s.op == "shrink") && s.args[0].constant() && s.args[0].a == 1.f)
+		s.op = "union";
+
+	if (s.op == "union") {
+		std::vector<SceneShape> flat;
+		for (SceneShape& child : s.children) {
+			if (child.op != "union") {
+				flat.push_back(std::move(child));
+				continue;
+			}
+			for (SceneShape& grandchild : child.children)
+				flat.push_back(std::move(grandchild));
+			folded++;
+		}
+		s.children = std::move(flat);
+	}
+	if (s.children.size() == 1 && (s.op == "union" || s.op == "intersect" || s.op == "subtract" || s.op == "smooth"))
+		collapse(s, folded);
+	return true;
+}
+
+static int countShapes(const SceneShape& s) {
+	int n = 1;
+	for (const SceneShape& child : s.children)
+		n += countShapes(child);
+	return n;
+}
+
+// use[material]: 0 unused, 1 only on static shapes, 2 on an animated one.
+static void markMaterials(const SceneShape& s, bool animated, std::vector<int>& use) {
+	for (const SceneCurve& c : s.args)
+		animated = animated || !c.constant();
+	if (s.primitive())
+		use[s.mat] = glm::max(use[s.mat], animated ? 2 : 1);
+	for (const SceneShape& child : s.children)
+		markMaterials(child, animated, use);
+}
+
+bool isAnimated(const SceneShape& s, bool animated) {
+	for (const SceneCurve& c : s.args)
+		animated = animated || !c.constant();
+	for (const SceneShape& child : s.children)
+		animated = isAnimated(child, animated);
+	return animated;
+}
+
+int numberMaterials(const Scene& scene, std::vector<int>& ids, int& count) {
+	std::vector<int> use(scene.materials.size(), 0);
+	markMaterials(scene.root, false, use);
+
+	// Material 1 has to be static for reproject.vert, so when every material moves an unused one goes first.
+	ids.assign(scene.materials.size(), 0);
+	int statics = 0;
+	count = 0;
+	for (int pass = 1; pass <= 2; pass++) {
+		if (pass == 2 && statics == 0)
+			statics = count = 1;
+		for (size_t i = 0; i < use.size(); i++)
+			if (use[i] == pass) {
+				ids[i] = ++count;
+				statics += pass == 1;
+			}
+	}
+	return statics;
+}
+
+/******||GLSL||******/
+
+static std::string lit(float v) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.7g", v);
+	std::string s = buf;
+	if (s.find_first_of(".e") == std::string::npos)
+		s += ".";
+	return s;
+}
+
+static std::string curveGLSL(const SceneCurve& c) {
+	switch (c.type) {
+	case SceneCurve::LINEAR:
+		return c.b == 0.f ? "time*" + lit(c.a) : "(time*" + lit(c.a) + " + " + lit(c.b) + ")";
+	case SceneCurve::SINE:
+		return std::string("(") + (c.d == 0.f ? "" : lit(c.d) + " + ") + lit(c.a) + "*sin(time*" + lit(c.b) + (c.c == 0.f ? "" : " + " + lit(c.c)) + "))";
+	case SceneCurve::SMOOTHSINE:
+		return "smoothstep(" + lit(c.a) + ", " + lit(c.b) + ", sin(time*" + lit(c.c) + "))";
+	default:
+		return lit(c.a);
+	}
+}
+
+struct SceneEmitter {
+	std::string code;
+	std::vector<int> ids; // shader material of every material in the file
+	int names = 0;
+
+	void line(int depth, const std::string& text) { code += std::string(2 * depth + 2, ' ') + text + "\n"; }
+	std::string name(const char* prefix) { return prefix + std::to_string(names++); }
+
+	int firstMaterial(const SceneShape& s) const {
+		return s.primitive() ? ids[s.mat] : firstMaterial(s.children[0]);
+	}
+
+	// A curve as an expression, or as a variable holding it when it's animated and used more than once.
+	std::string value(int depth, const SceneCurve& c, const char* prefix) {
+		if (c.constant())
+			return lit(c.a);
+		std::string v = name(prefix);
+		line(depth, "float " + v + " = " + curveGLSL(c) + ";");
+		return v;
+	}
+
+	std::string primitive(const SceneShape& s, const std::string& p) {
+		const std::vector<float>& n = s.sizes;
+		if (s.op == "sphere")
+			return "sdfSphere(" + p + ", " + lit(n[0]) + ")";
+		if (s.op == "box")
+			return "sdfBox(" + p + ", vec3(" + lit(n[0]) + ", " + lit(n[1]) + ", " + lit(n[2]) + "))" + (s.round == 0.f ? "" : " - " + lit(s.round));
+		if (s.op == "torus")
+			return "sdfTorus(" + p + ", " + lit(n[0]) + ", " + lit(n[1]) + ")";
+		if (s.op == "slab")
+			return "abs(" + p + "." + s.axes + (n[0] == 0.f ? "" : n[0] < 0.f ? " + " + lit(-n[0]) : " - " + lit(n[0])) + ") - " + lit(n[1]);
+		return "sdfRhombicIcos(" + p + ", 1.)";
+	}
+
+	// Writes the code that puts s into data wherever it's nearer than what data holds, p being the point in s's space.
+	void emit(const SceneShape& s, const std::string& p, const std::string& data, int depth) {
+		if (s.primitive()) {
+			line(depth, "d = " + primitive(s, p) + ";");
+			line(depth, "if(d < " + data + "[0]) " + data + " = float[](d, " + lit(float(ids[s.mat])) + ");");
+			return;
+		}
+		if (s.op == "union") {
+			for (const SceneShape& child : s.children)
+				emit(child, p, data, depth);
+			return;
+		}
+		if (s.op == "bound") {
+			glm::vec3 c(s.sizes[0], s.sizes[1], s.sizes[2]);
+			std::string center = c == glm::vec3(0.f) ? p : p + " - vec3(" + lit(c.x) + ", " + lit(c.y) + ", " + lit(c.z) + ")";
+			line(depth, "if(inBound(" + data + ", sdfSphere(" + center + ", " + lit(s.sizes[3]) + "), " + lit(float(firstMaterial(s))) + ")) {");
+			for (const SceneShape& child : s.children)
+				emit(child, p, data, depth + 1);
+			line(depth, "}");
+			return;
+		}
+
+		if (s.op == "translate" || s.op == "rotate" || s.op == "mirror") {
+			std::string q = name("p");
+			if (s.op == "translate")
+				line(depth, "vec3 " + q + " = " + p + " - vec3(" + curveGLSL(s.args[0]) + ", " + curveGLSL(s.args[1]) + ", " + curveGLSL(s.args[2]) + ");");
+			else {
+				line(depth, "vec3 " + q + " = " + p + ";");
+				if (s.op == "mirror")
+					line(depth, q + "." + s.axes + " = abs(" + q + "." + s.axes + ");");
+				else if (s.args[0].constant()) {
+					float sn = std::sin(s.args[0].a), cs = std::cos(s.args[0].a);
+					line(depth, q + "." + s.axes + " *= mat2(" + lit(cs) + ", " + lit(-sn) + ", " + lit(sn) + ", " + lit(cs) + ");");
+				}
+				else
+					line(depth, q + "." + s.axes + " *= rotationMatrix(" + curveGLSL(s.args[0]) + ");");
+			}
+			for (const SceneShape& child : s.children)
+				emit(child, q, data, depth);
+			return;
+		}
+
+		if (s.op == "scale" || s.op == "shrink") {
+			// Inside, only what's nearer than data scaled down can win, and whatever does comes out nearer than data.
+			std::string k = value(depth, s.args[0], "k"), q = p, inner = name("d");
+			if (s.op == "scale") {
+				q = name("p");
+				line(depth, "vec3 " + q + " = " + p + "/" + k + ";");
+			}
+			line(depth, "float[2] " + inner + " = float[](" + data + "[0]/" + k + ", " + data + "[1]);");
+			for (const SceneShape& child : s.children)
+				emit(child, q, inner, depth);
+			line(depth, data + " = float[](" + inner + "[0]*" + k + ", " + inner + "[1]);");
+			return;
+		}
+
+		// The rest combine their shapes' distances, so each shape gets one of its own.
+		std::vector<std::string> parts;
+		for (const SceneShape& child : s.children) {
+			parts.push_back(name("d"));
+			line(depth, "float[2] " + parts.back() + " = float[](FAR, 0.);");
+			emit(child, p, parts.back(), depth);
+		}
+		const std::string& a = parts[0];
+		std::string k = s.op == "smooth" || s.op == "morph" ? value(depth, s.args[0], s.op == "smooth" ? "k" : "t") : "";
+		for (size_t i = 1; i < parts.size(); i++) {
+			const std::string& b = parts[i];
+			if (s.op == "intersect")
+				line(depth, "if(" + b + "[0] > " + a + "[0]) " + a + " = " + b + ";");
+			else if (s.op == "subtract")
+				line(depth, a + "[0] = max(" + a + "[0], -" + b + "[0]);");
+			else if (s.op == "smooth") {
+				std::string h = name("h");
+				line(depth, "float " + h + " = clamp(0.5 + 0.5*(" + b + "[0] - " + a + "[0])/" + k + ", 0., 1.);");
+				line(depth, a + " = float[](mix(" + b + "[0], " + a + "[0], " + h + ") - " + k + "*" + h + "*(1. - " + h + "), " + h + " > 0.5 ? " + a + "[1] : " + b + "[1]);");
+			}
+			else {
+				std::string mat = !s.args[0].constant() ? k + " < 0.5 ? " + a + "[1] : " + b + "[1]" : s.args[0].a < 0.5f ? a + "[1]" : b + "[1]";
+				line(depth, a + " = float[](mix(" + a + "[0], " + b + "[0], " + k + "), " + mat + ");");
+			}
+		}
+		line(depth, "if(" + a + "[0] < " + data + "[0]) " + data + " = " + a + ";");
+	}
+};
+
+bool loadScene(const char* path, Scene& out) {
+	SceneParser parser;
+	parser.path = path;
+	out = Scene();
+	if (!tokenize(path, parser.tokens) || !parser.parse(out.root))
+		return false;
+
+	if (!simplify(out.root, out.folded)) {
+		printf("%s: no shapes to march\n", path);
+		return false;
+	}
+	out.materials = parser.materials;
+	out.lights = parser.lights;
+	return true;
+}
+
+bool compileScene(const char* path, CompiledScene& out) {
+	Scene scene;
+	if (!loadScene(path, scene))
+		return false;
+
+	SceneEmitter emitter;
+	int count, statics = numberMaterials(scene, emitter.ids, count);
+	std::vector<std::string> entries(count, "  Material(vec4(0), 1., 0., 0.), // unused, material 1 stays static");
+	std::string checkered;
+	for (size_t i = 0; i < scene.materials.size(); i++) {
+		const SceneMaterial& m = scene.materials[i];
+		int id = emitter.ids[i];
+		if (id == 0)
+			continue;
+		entries[id - 1] = "  Material(vec4(" + lit(m.albedo.r) + ", " + lit(m.albedo.g) + ", " + lit(m.albedo.b) + ", " + lit(m.albedo.a) + "), " +
+			lit(m.rough) + ", " + lit(m.metal) + ", " + lit(m.iref) + "), // " + m.name;
+		if (m.checker)
+			checkered += (checkered.empty() ? "" : " || ") + std::string("id == ") + std::to_string(id);
+	}
+	entries.back().erase(entries.back().find(", //"), 1);
+
+	emitter.line(0, "float d;");
+	emitter.emit(scene.root, "p", "data", 0);
+
+	std::string& code = out.defines;
+	code = "#define SCENE\n" SCENE_BEGIN;
+	code += std::string("// Compiled from ") + path + " by the scene compiler, see SceneCompiler.h.\n";
+	code += "#undef ANIMATED\n#define ANIMATED(mat) (mat > " + lit(float(statics)) + ")\n";
+	code += "#undef CHECKERED\n#define CHECKERED(id) (" + (checkered.empty() ? std::string("false") : checkered) + ")\n";
+	code += "Material materials[] = Material[](\n";
+	for (const std::string& entry : entries)
+		code += entry + "\n";
+	code += ");\n";
+	code += "void sceneSdf(in vec3 p, inout float[2] data) {\n" + emitter.code + "}\n";
+	code += SCENE_END;
+
+	out.lights = scene.lights;
+	out.statics = statics;
+	out.shapes = countShapes(scene.root);
+	out.folded = scene.folded;
+	printf("Compiled scene %s: %d shapes, %d folded away, %d materials, %d lights\n", path, out.shapes, out.folded, count, int(out.lights.size()));
+	return true;
+}
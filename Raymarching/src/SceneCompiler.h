@@ -0,0 +1,108 @@
+#pragma once
+#include "LightBuffer.h"
+#include <glm/vec4.hpp>
+#include <string>
+#include <vector>
+
+/*
+SCENE FILES:
+  A scene file describes what sdf() marches in place of the scene written into screen.frag. compileScene() turns it into
+  GLSL once at startup: a materials[] array and a sceneSdf() with every constant written in as a literal, so the shader
+  compiler gets the same kind of straight line code as the hand written scene and nothing is looked up per step.
+
+  Plain text, '#' starts a comment and line breaks are whitespace. The file is a list of:
+    material <name> <r> <g> <b> [emissive E] [rough R] [metal M] [iref I] [checker]
+    light <x> <y> <z> <r> <g> <b> [strength S] [radius R] [spin RATE]
+    <shape>
+
+  A shape is a primitive or an operation on the shapes in the braces after it:
+    sphere <r>                          box <x> <y> <z> [round R]           torus <r1> <r2>
+    slab <axis> <pos> <half>            icosahedron
+    union { }                           the nearest of them. The top level of the file is one
+    intersect { }                       the furthest
+    subtract { }                        the first with the rest cut out of it
+    smooth <k> { }                      blended, polynomial smooth minimum of radius k
+    morph <t> { a b }                   a at t = 0, b at t = 1
+    translate <x> <y> <z> { }           moved
+    rotate <plane> <angle> { }          turned, p.<plane> *= rotationMatrix(angle) like screen.frag
+    mirror <axes> { }                   mirrored onto the positive side of each axis
+    scale <s> { }                       s times bigger
+    shrink <k> { }                      distances times k < 1, for shapes whose sdf overestimates
+    bound <x> <y> <z> <r> { }           skipped or stood in for by this sphere, see inBound() in screen.frag
+  Primitives take 'mat <name>' after their sizes, the first material by default. Any shape can be turned 'off'.
+
+  Every number after translate, rotate, scale, shrink, smooth and morph can also be an animation curve of time in ms:
+    lin(rate[,offset])                  offset + rate*time
+    sin(amp,rate[,phase[,offset]])      offset + amp*sin(rate*time + phase)
+    smoothsin(lo,hi,rate)               smoothstep(lo, hi, sin(rate*time))
+  A light's spin is how fast it circles the y axis, radians per ms, and goes to the LightBuffer with the rest of it.
+
+  Before writing anything out the compiler folds what it can: shapes that are off, empty operations, identity
+  transforms and curves that never change go away, constant morphs keep the one shape they show, single shape unions
+  and intersections and nested unions collapse, nested constant translations and rotations in the same plane add up,
+  and constant rotations go in as literal matrices. Materials no shape uses are dropped. The rest are numbered static
+  first, so ANIMATED() is one compare and material 1 is static the way reproject.vert assumes.
+
+  loadScene() stops after folding and leaves the scene in the structures below, which SceneInterpreter.h encodes
+  instead, so a scene can change without a recompile. The compiled result travels in the defines: SCENE defined, then
+  the code between SCENE_BEGIN and SCENE_END, which LoadShaders() moves to the SCENE_MARKER line in screen.frag. Normals
+  and the brick map only know the built-in scene, so NORMALS 2 falls back to 1 and there is no -bricks with a scene.
+*/
+
+#define SCENE_BEGIN "#pragma scene begin\n"
+#define SCENE_END "#pragma scene end\n"
+#define SCENE_MARKER "#pragma scene"
+
+struct SceneCurve {
+	enum Type { CONSTANT, LINEAR, SINE, SMOOTHSINE } type = CONSTANT;
+	float a = 0.f, b = 0.f, c = 0.f, d = 0.f; // the arguments in the order above, a the constant
+	bool constant() const { return type == CONSTANT; }
+	float at(double time) const;
+};
+
+struct SceneMaterial {
+	std::string name;
+	glm::vec4 albedo; // rgb, emissive in a
+	float rough = 1.f, metal = 0.f, iref = 0.f;
+	bool checker = false;
+};
+
+struct SceneShape {
+	std::string op;
+	std::string axes; // slab, rotate and mirror
+	std::vector<float> sizes; // a primitive's and a bound's
+	std::vector<SceneCurve> args; // an operation's
+	float round = 0.f;
+	int mat = 0; // into Scene::materials
+	bool off = false;
+	std::vector<SceneShape> children;
+	int line = 0;
+
+	bool primitive() const;
+};
+
+struct Scene {
+	std::vector<SceneMaterial> materials;
+	std::vector<LightSource> lights;
+	SceneShape root; // a union of the file's shapes
+	int folded = 0; // shapes, transforms and curves folded away
+};
+
+struct CompiledScene {
+	std::string defines; // for LoadShaders
+	std::vector<LightSource> lights;
+	int shapes = 0; // after folding
+	int statics = 1; // materials that don't move, what ANIMATED() tests against
+	int folded = 0; // shapes, transforms and curves folded away
+};
+
+// Parses and folds a scene file. Prints what's wrong with it and returns false if anything is.
+bool loadScene(const char* path, Scene& out);
+// loadScene() and the GLSL for it.
+bool compileScene(const char* path, CompiledScene& out);
+
+// The shader's material of every one of the scene's in ids, 0 for unused ones, static first. Returns how many are
+// static, an unused placeholder included when nothing is, and sets count to how many the shader has.
+int numberMaterials(const Scene& scene, std::vector<int>& ids, int& count);
+// Whether anything under s moves, given whether something around it does.
+bool isAnimated(const SceneShape& s, bool animated = false);
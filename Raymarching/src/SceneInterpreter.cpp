@@ -0,0 +1,182 @@
+#include "SceneInterpreter.h"
+#include "Clock.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+static int axisIndex(char axis) { return axis - 'x'; }
+
+SceneInterpreter::SceneInterpreter(const Scene& scene, const char* path) {
+	glGenBuffers(1, &TBO);
+	glGenTextures(1, &texture);
+	glActiveTexture(GL_TEXTURE0 + SCENE_CODE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	if (!replace(scene))
+		printf("Scene interpreter: the scene nests deeper than %d, nothing to march\n", SCENE_STACK);
+
+	if (path != NULL) {
+		std::error_code ec;
+		this->path = path;
+		stamp = std::filesystem::last_write_time(path, ec);
+		checked = nowMillis();
+	}
+}
+SceneInterpreter::~SceneInterpreter() {
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &TBO);
+}
+
+void SceneInterpreter::attach(GLuint program, const UniformBinding& uniforms) {
+	GLint loc = uniforms.location(program, "sceneCode");
+	if (loc == -1)
+		return;
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(program);
+	glUniform1i(loc, SCENE_CODE_UNIT);
+	glUseProgram(previous);
+}
+
+bool SceneInterpreter::replace(const Scene& next) {
+	std::vector<int> nextIds;
+	int count, nextStatics = numberMaterials(next, nextIds, count);
+	std::swap(ids, nextIds);
+
+	code.assign(1, glm::vec4(0.f));
+	depth = glm::ivec2(0);
+	encode(next.root, 0.0, 0, 0);
+	if (depth.x > SCENE_STACK || depth.y > SCENE_STACK) {
+		printf("Scene interpreter: shapes nest %d transforms and %d operations deep, only %d fit\n", depth.x, depth.y, SCENE_STACK);
+		std::swap(ids, nextIds);
+		return false;
+	}
+
+	scene = next;
+	statics = nextStatics;
+	materials = count;
+	animated = isAnimated(scene.root);
+	uploaded = false;
+	return true;
+}
+
+void SceneInterpreter::emit(SceneOp op, glm::vec3 small, glm::vec4 numbers) {
+	code.push_back(glm::vec4(float(op), small));
+	code.push_back(numbers);
+}
+
+void SceneInterpreter::encode(const SceneShape& s, double time, int points, int stack) {
+	if (s.op.empty()) // no scene
+		return;
+	depth = glm::max(depth, glm::ivec2(points, stack));
+	const std::vector<float>& n = s.sizes;
+	float mat = s.primitive() ? float(ids[s.mat]) : 0.f;
+
+	if (s.op == "sphere")
+		emit(OP_SPHERE, glm::vec3(mat, 0.f, 0.f), glm::vec4(n[0], 0.f, 0.f, 0.f));
+	else if (s.op == "box")
+		emit(OP_BOX, glm::vec3(mat, 0.f, 0.f), glm::vec4(n[0], n[1], n[2], s.round));
+	else if (s.op == "torus")
+		emit(OP_TORUS, glm::vec3(mat, 0.f, 0.f), glm::vec4(n[0], n[1], 0.f, 0.f));
+	else if (s.op == "slab")
+		emit(OP_SLAB, glm::vec3(mat, float(axisIndex(s.axes[0])), 0.f), glm::vec4(n[0], n[1], 0.f, 0.f));
+	else if (s.op == "icosahedron")
+		emit(OP_ICOSAHEDRON, glm::vec3(mat, 0.f, 0.f), glm::vec4(0.f));
+	else if (s.op == "union") {
+		for (const SceneShape& child : s.children)
+			encode(child, time, points, stack);
+	}
+	else if (s.op == "bound") {
+		// Skips as many instructions as the shapes inside turn out to take.
+		size_t at = code.size();
+		emit(OP_BOUND, glm::vec3(0.f), glm::vec4(n[0], n[1], n[2], n[3]));
+		for (const SceneShape& child : s.children)
+			encode(child, time, points, stack);
+		const SceneShape* first = &s;
+		while (!first->primitive())
+			first = &first->children[0];
+		code[at] = glm::vec4(float(OP_BOUND), float(ids[first->mat]), float((code.size() - at) / 2 - 1), 0.f);
+	}
+	else if (s.op == "translate" || s.op == "rotate" || s.op == "mirror") {
+		if (s.op == "translate")
+			emit(OP_TRANSLATE, glm::vec3(0.f), glm::vec4(s.args[0].at(time), s.args[1].at(time), s.args[2].at(time), 0.f));
+		else if (s.op == "rotate") {
+			float angle = s.args[0].at(time);
+			emit(OP_ROTATE, glm::vec3(float(axisIndex(s.axes[0])), float(axisIndex(s.axes[1])), 0.f), glm::vec4(std::cos(angle), std::sin(angle), 0.f, 0.f));
+		}
+		else {
+			glm::vec4 mask(0.f);
+			for (char axis : s.axes)
+				mask[axisIndex(axis)] = 1.f;
+			emit(OP_MIRROR, glm::vec3(0.f), mask);
+		}
+		for (const SceneShape& child : s.children)
+			encode(child, time, points + 1, stack);
+		emit(OP_POP, glm::vec3(0.f), glm::vec4(0.f));
+	}
+	else if (s.op == "scale" || s.op == "shrink") {
+		float k = s.args[0].at(time), moves = s.op == "scale" ? 1.f : 0.f;
+		emit(OP_SCALE, glm::vec3(moves, 0.f, 0.f), glm::vec4(k, 0.f, 0.f, 0.f));
+		for (const SceneShape& child : s.children)
+			encode(child, time, points + int(moves), stack + 1);
+		emit(OP_UNSCALE, glm::vec3(moves, 0.f, 0.f), glm::vec4(k, 0.f, 0.f, 0.f));
+	}
+	else {
+		SceneOp op = s.op == "intersect" ? OP_INTERSECT : s.op == "subtract" ? OP_SUBTRACT : s.op == "smooth" ? OP_SMOOTH : OP_MORPH;
+		float k = s.args.empty() ? 0.f : s.args[0].at(time);
+		for (size_t i = 0; i < s.children.size(); i++) {
+			emit(OP_PUSH, glm::vec3(0.f), glm::vec4(0.f));
+			encode(s.children[i], time, points, stack + (i == 0 ? 1 : 2));
+			if (i > 0)
+				emit(op, glm::vec3(0.f), glm::vec4(k, 0.f, 0.f, 0.f));
+		}
+		emit(OP_MERGE, glm::vec3(0.f), glm::vec4(0.f));
+	}
+}
+
+void SceneInterpreter::update(double time) {
+	if (!path.empty() && nowMillis() - checked > SCENE_WATCH) {
+		checked = nowMillis();
+		std::error_code ec;
+		std::filesystem::file_time_type now = std::filesystem::last_write_time(path, ec);
+		if (!ec && now != stamp) {
+			stamp = now;
+			Scene edited;
+			if (loadScene(path.c_str(), edited) && replace(edited))
+				printf("Reloaded %s: %d instructions\n", path.c_str(), instructions());
+		}
+	}
+	if (!valid() || (uploaded && !animated))
+		return;
+
+	code.assign(1, glm::vec4(0.f));
+	encode(scene.root, time, 0, 0);
+	int end = int(code.size());
+	code[0] = glm::vec4(float(end), float(end), float(statics), 0.f);
+
+	std::vector<int> order(materials, -1);
+	for (size_t i = 0; i < ids.size(); i++)
+		if (ids[i] != 0)
+			order[ids[i] - 1] = int(i);
+	for (int i : order) {
+		if (i == -1) { // the placeholder keeping material 1 static
+			code.push_back(glm::vec4(0.f));
+			code.push_back(glm::vec4(1.f, 0.f, 0.f, 0.f));
+			continue;
+		}
+		const SceneMaterial& m = scene.materials[i];
+		code.push_back(m.albedo);
+		code.push_back(glm::vec4(m.rough, m.metal, m.iref, m.checker ? 1.f : 0.f));
+	}
+
+	// Orphaned like the light clusters, the draws still reading last frame's don't hold this one up.
+	glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * code.size(), code.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	uploaded = true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "SceneCompiler.h"
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+/*
+SCENE INTERPRETER:
+  The other way to run a scene file. screen.frag built with SCENE_INTERPRETER has one sceneSdf() that reads the scene as
+  bytecode from a texture buffer, so a different or edited scene is an upload instead of a program build that takes
+  seconds. The price is paid on every sdf() call: a fetch and a chain of branches per instruction where the compiled
+  scene is straight line code with its constants in it, and nothing the shader compiler can fold or hoist.
+
+  Texel 0 is the header: where the code ends, where the materials start and how many of them are static. The code
+  follows, two RGBA32F texels per instruction, the op and up to three small arguments, then four numbers. Then two
+  texels per material, its albedo, then rough, metal, iref and whether it's checkered. The instructions work on the
+  nearest distance and material so far, a stack of them for shapes that combine, and a stack of points for transforms;
+  sceneSdf() in screen.frag has the details.
+
+  Curves are evaluated here, not per pixel: update() encodes the scene at the frame's time, so the shader only ever sees
+  numbers, rotations as a cosine and a sine. A scene that doesn't move is uploaded once. Given the path of the file,
+  update() also looks at it every SCENE_WATCH ms and uploads it again when it was saved, lights excepted.
+*/
+
+#define SCENE_CODE_UNIT 13
+#define SCENE_STACK 8 // screen.frag has the same
+#define SCENE_WATCH 500.0 // ms
+
+// The instructions, screen.frag has the same.
+enum SceneOp {
+	OP_SPHERE = 1, OP_BOX, OP_TORUS, OP_SLAB, OP_ICOSAHEDRON,
+	OP_TRANSLATE = 10, OP_ROTATE, OP_MIRROR, OP_POP,
+	OP_BOUND = 20,
+	OP_PUSH = 30, OP_SCALE, OP_UNSCALE,
+	OP_INTERSECT = 40, OP_SUBTRACT, OP_SMOOTH, OP_MORPH, OP_MERGE,
+};
+
+class SceneInterpreter {
+public:
+	// Keeps a copy of the scene. With a path it reloads the file whenever it changes.
+	SceneInterpreter(const Scene& scene, const char* path = NULL);
+	~SceneInterpreter();
+
+	// Points a program's sceneCode sampler at the buffer.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	// Encodes the scene at 'time' (ms) and uploads it, unless it can't have changed since the last upload.
+	void update(double time);
+
+	// Swaps in another scene for the next update() to upload. False, keeping the old one, if its shapes nest deeper
+	// than SCENE_STACK.
+	bool replace(const Scene& scene);
+
+	int instructions() const { return int(code.size() - 1) / 2; }
+	// The current scene's materials that don't move, as the header tells screen.frag.
+	int staticMaterials() const { return statics; }
+	// False if the constructor's scene was refused, nothing gets uploaded then.
+	bool valid() const { return !scene.root.op.empty(); }
+
+	// For LoadShaders, instead of a CompiledScene's.
+	static const char* defines() { return "#define SCENE\n#define SCENE_INTERPRETER\n"; }
+
+private:
+	// Appends s at 'time' to code. points and stack are how deep those are around it, and the deepest go to depth.
+	void encode(const SceneShape& s, double time, int points, int stack);
+	void emit(SceneOp op, glm::vec3 small, glm::vec4 numbers);
+
+	Scene scene;
+	std::vector<int> ids;
+	int statics = 0, materials = 0;
+	bool animated = false, uploaded = false;
+
+	std::vector<glm::vec4> code;
+	glm::ivec2 depth = glm::ivec2(0); // points, stack
+
+	std::string path;
+	std::filesystem::file_time_type stamp;
+	double checked = 0.0;
+
+	GLuint TBO = 0, texture = 0;
+};
@@ -0,0 +1,114 @@
+#include "ShaderCache.h"
+#include "Extensions.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <stdio.h>
+
+#define CACHE_MAGIC 0x52434143u // "CACR"
+
+static unsigned long long fnv1a(const char* data, size_t size, unsigned long long hash = 14695981039346656037ull) {
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+static unsigned long long fnv1a(const std::string& s, unsigned long long hash) {
+	// Length first so "ab"+"c" and "a"+"bc" don't collide.
+	size_t size = s.size();
+	hash = fnv1a((const char*)&size, sizeof(size), hash);
+	return fnv1a(s.data(), s.size(), hash);
+}
+static std::string glString(GLenum name) {
+	const char* s = (const char*)glGetString(name);
+	return s != NULL ? s : "";
+}
+static std::string cachePath(const std::string& key) {
+	return std::string(SHADER_CACHE_DIR) + "/" + key + ".bin";
+}
+
+std::string programCacheKey(const std::string& vertexSource, const std::string& fragmentSource) {
+	unsigned long long hash = 14695981039346656037ull;
+	hash = fnv1a(vertexSource, hash);
+	hash = fnv1a(fragmentSource, hash);
+	hash = fnv1a(glString(GL_VENDOR), hash);
+	hash = fnv1a(glString(GL_RENDERER), hash);
+	hash = fnv1a(glString(GL_VERSION), hash);
+
+	char key[17];
+	snprintf(key, sizeof(key), "%016llx", hash);
+	return key;
+}
+
+GLuint loadCachedProgram(const std::string& key) {
+	if (!GLEXT.programBinary)
+		return 0;
+
+	std::ifstream in(cachePath(key), std::ios::binary);
+	if (!in.is_open())
+		return 0;
+
+	unsigned int magic = 0;
+	GLenum format = 0;
+	GLint length = 0;
+	in.read((char*)&magic, sizeof(magic));
+	in.read((char*)&format, sizeof(format));
+	in.read((char*)&length, sizeof(length));
+	if (!in || magic != CACHE_MAGIC || length <= 0)
+		return 0;
+
+	std::vector<char> binary(length);
+	in.read(binary.data(), length);
+	if (!in)
+		return 0;
+	in.close();
+
+	GLuint program = glCreateProgram();
+	GLEXT.ProgramBinary(program, format, binary.data(), length);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE) {
+		printf("Cached program %s was rejected by the driver, recompiling\n", key.c_str());
+		glDeleteProgram(program);
+		std::error_code ec;
+		std::filesystem::remove(cachePath(key), ec);
+		return 0;
+	}
+	return program;
+}
+
+void storeCachedProgram(const std::string& key, GLuint program) {
+	if (!GLEXT.programBinary)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLEXT.GetProgramBinary(program, length, &length, &format, binary.data());
+	if (length <= 0)
+		return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(SHADER_CACHE_DIR, ec);
+
+	// Write to a temporary name first so a crash never leaves a truncated binary behind.
+	std::string path = cachePath(key), temp = path + ".tmp";
+	std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return;
+
+	unsigned int magic = CACHE_MAGIC;
+	out.write((const char*)&magic, sizeof(magic));
+	out.write((const char*)&format, sizeof(format));
+	out.write((const char*)&length, sizeof(length));
+	out.write(binary.data(), length);
+	out.close();
+
+	std::filesystem::rename(temp, path, ec);
+}
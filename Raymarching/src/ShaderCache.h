@@ -0,0 +1,20 @@
+#pragma once
+#include <glad/glad.h>
+#include <string>
+
+/*
+PROGRAM BINARY CACHE:
+  Linked programs are saved to SHADER_CACHE_DIR/<key>.bin with glGetProgramBinary and loaded back with glProgramBinary.
+  The key hashes the final shader sources (so any #define in or injected into them counts) together with the
+  GL vendor, renderer and version strings, so a driver update never picks up a stale binary.
+  A binary the driver rejects is deleted and the caller compiles from source as usual.
+*/
+
+#define SHADER_CACHE_DIR "shadercache"
+
+std::string programCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+
+// Returns 0 on a miss or when the driver rejects the stored binary.
+GLuint loadCachedProgram(const std::string& key);
+// Must be called on a successfully linked program created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void storeCachedProgram(const std::string& key, GLuint program);
@@ -0,0 +1,133 @@
+#include "ShaderVariants.h"
+#include "Clock.h"
+#include <set>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+const QualityTier QUALITY[QUALITY_TIERS] = {
+	{ "low", "#define STEPS 100\n#define SHA_STEPS 40\n#define BOUNCES 2\n#define AO 0\n" },
+	{ "medium", "#define STEPS 200\n#define SHA_STEPS 100\n#define BOUNCES 4\n#define AO_SAMPLES 5.\n" },
+	{ "high", "" },
+	{ "ultra", "#define SHADOWS 1\n#define AO_SAMPLES 16.\n" },
+};
+
+int qualityTier(const char* name) {
+	for (int i = 0; i < QUALITY_TIERS; i++)
+		if (strcmp(QUALITY[i].name, name) == 0)
+			return i;
+	return -1;
+}
+
+// The NAME of every '#define NAME' line.
+static std::set<std::string> definedNames(const std::string& defines) {
+	std::set<std::string> names;
+	std::istringstream lines(defines);
+	std::string line, directive, name;
+	while (std::getline(lines, line)) {
+		std::istringstream words(line);
+		if (words >> directive >> name && directive == "#define")
+			names.insert(name.substr(0, name.find('(')));
+	}
+	return names;
+}
+
+std::string variantDefines(const std::string& base, const std::string& variant) {
+	std::set<std::string> taken = definedNames(base);
+	std::string out = base;
+	std::istringstream lines(variant);
+	std::string line;
+	while (std::getline(lines, line)) {
+		std::set<std::string> names = definedNames(line);
+		if (names.empty() || taken.count(*names.begin()) == 0)
+			out += line + "\n";
+	}
+	return out;
+}
+
+ShaderVariants::ShaderVariants(ProgramBuilder& builder, const char* vertex, const char* fragment, const std::string& defines)
+	: builder(builder), vertex(vertex), fragment(fragment), base(defines) {
+	std::error_code ec;
+	stamps[0] = std::filesystem::last_write_time(vertex, ec);
+	stamps[1] = std::filesystem::last_write_time(fragment, ec);
+	checked = nowMillis();
+}
+ShaderVariants::~ShaderVariants() {
+	for (auto& entry : variants) {
+		if (entry.second.ticket != -1)
+			glDeleteProgram(builder.wait(entry.second.ticket));
+		glDeleteProgram(entry.second.program);
+	}
+}
+
+void ShaderVariants::start(const std::string& name, Variant& v) {
+	v.ticket = builder.start(vertex.c_str(), fragment.c_str(), defines(name));
+	v.again = false;
+}
+void ShaderVariants::done(const std::string& name, Variant& v, GLuint program) {
+	v.ticket = -1;
+	v.failed = program == 0;
+	if (program != 0) {
+		// Whoever draws with the old one switches in the same frame, GL holds on to it until then.
+		glDeleteProgram(v.program);
+		v.program = program;
+	}
+	else if (v.program != 0)
+		printf("%s didn't build, keeping the last program that did\n", fragment.c_str());
+	if (v.again)
+		start(name, v);
+}
+
+GLuint ShaderVariants::build(const std::string& variant) {
+	Variant& v = variants[variant];
+	if (v.ticket == -1 && v.program == 0 && !v.failed)
+		start(variant, v);
+	while (v.ticket != -1)
+		done(variant, v, builder.wait(v.ticket));
+	return v.program;
+}
+
+void ShaderVariants::request(const std::string& variant) {
+	if (variants.count(variant) != 0)
+		return;
+	start(variant, variants[variant]);
+}
+
+GLuint ShaderVariants::find(const std::string& variant) const {
+	auto at = variants.find(variant);
+	return at != variants.end() ? at->second.program : 0;
+}
+bool ShaderVariants::failed(const std::string& variant) const {
+	auto at = variants.find(variant);
+	return at != variants.end() && at->second.failed && at->second.program == 0 && at->second.ticket == -1;
+}
+
+void ShaderVariants::rebuild() {
+	for (auto& entry : variants) {
+		if (entry.second.ticket != -1)
+			entry.second.again = true;
+		else
+			start(entry.first, entry.second);
+	}
+}
+
+void ShaderVariants::update() {
+	if (watching && nowMillis() - checked > SHADER_WATCH) {
+		checked = nowMillis();
+		std::error_code ec;
+		std::filesystem::file_time_type now[2] = {
+			std::filesystem::last_write_time(vertex, ec), std::filesystem::last_write_time(fragment, ec)
+		};
+		if (now[0] != stamps[0] || now[1] != stamps[1]) {
+			stamps[0] = now[0];
+			stamps[1] = now[1];
+			printf("%s changed, rebuilding %d variants\n", fragment.c_str(), int(variants.size()));
+			rebuild();
+		}
+	}
+
+	GLuint program;
+	for (auto& entry : variants)
+		if (entry.second.ticket != -1 && builder.poll(entry.second.ticket, program))
+			done(entry.first, entry.second, program);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "ProgramBuilder.h"
+#include <glad/glad.h>
+#include <filesystem>
+#include <map>
+#include <string>
+
+/*
+SHADER VARIANTS:
+  One shader built with different sets of defines, each its own program. A variant is named by the defines it adds on
+  top of the ones the manager was made with. A define the base already has wins, so a -D from the command line holds
+  in every variant.
+
+  Variants build on a ProgramBuilder. build() waits for one, request() doesn't and update(), called once a frame, picks
+  up whatever finished. Every program stays around until the manager is deleted, so asking for a variant again is free,
+  and the binary cache (ShaderCache.h) makes it cheap on the next run too.
+
+  update() also looks at the shader files every SHADER_WATCH ms and rebuilds every variant when one of them was saved.
+  Until a variant's new program is done, or if it doesn't build, find() keeps returning the one before. watch(false)
+  turns that off, for when other programs built from the same files can't follow.
+
+  The quality tiers are the variants the interactive mode switches between at runtime. high is screen.frag as written.
+*/
+
+#define SHADER_WATCH 500.0 // ms
+
+#define QUALITY_TIERS 4
+#define QUALITY_DEFAULT 2
+
+struct QualityTier {
+	const char* name;
+	const char* defines;
+};
+extern const QualityTier QUALITY[QUALITY_TIERS];
+
+// The tier called name, -1 if there's none.
+int qualityTier(const char* name);
+// base followed by the lines of variant that don't define something base already does.
+std::string variantDefines(const std::string& base, const std::string& variant);
+
+class ShaderVariants {
+public:
+	ShaderVariants(ProgramBuilder& builder, const char* vertex, const char* fragment, const std::string& defines = "");
+	// Deletes every program it built.
+	~ShaderVariants();
+
+	// The variant's program, waiting for it if it isn't built yet. 0 if it doesn't build.
+	GLuint build(const std::string& variant);
+	// Starts building the variant unless it's built or being built.
+	void request(const std::string& variant);
+	// The variant's latest program that built, 0 before the first one is done.
+	GLuint find(const std::string& variant) const;
+	// Whether the variant is done building and nothing came of it.
+	bool failed(const std::string& variant) const;
+	// Picks up the builds that finished, and rebuilds everything if the shader files changed.
+	void update();
+	// Builds every variant again from the files.
+	void rebuild();
+	// Whether update() looks at the files, on from the start.
+	void watch(bool on) { watching = on; }
+
+	// All the defines a variant is built with, for the other programs that should match it.
+	std::string defines(const std::string& variant) const { return variantDefines(base, variant); }
+
+private:
+	struct Variant {
+		GLuint program = 0;
+		int ticket = -1; // building while not -1
+		bool failed = false, again = false; // again: the files changed after this build started
+	};
+	void start(const std::string& name, Variant& v);
+	void done(const std::string& name, Variant& v, GLuint program);
+
+	ProgramBuilder& builder;
+	std::string vertex, fragment, base;
+	std::map<std::string, Variant> variants;
+
+	std::filesystem::file_time_type stamps[2];
+	double checked = 0.0;
+	bool watching = true;
+};
@@ -0,0 +1,77 @@
+#include "ShadowCache.h"
+#include "Raymarching.h"
+#include <stdio.h>
+#include <string>
+
+ShadowCache::ShadowCache(UniformBinding& uniforms, int tile, const char* defines) : tile(tile < 1 ? 1 : tile) {
+	program = LoadShaders("screen.vert", "screen.frag", (std::string(defines) + "#define SHADOW_PASS\n").c_str());
+	uniforms.attach(program);
+	attach(program, uniforms);
+}
+ShadowCache::~ShadowCache() {
+	if (FBO != 0) {
+		glDeleteFramebuffers(1, &FBO);
+		glDeleteTextures(1, &cache);
+	}
+	glDeleteProgram(program);
+}
+
+void ShadowCache::attach(GLuint target, const UniformBinding& uniforms) {
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(target);
+
+	GLint loc;
+	if ((loc = uniforms.location(target, "shadowCache")) != -1)
+		glUniform1i(loc, SHADOW_UNIT);
+	if ((loc = uniforms.location(target, "shadowTile")) != -1)
+		glUniform1f(loc, float(tile));
+
+	glUseProgram(previous);
+}
+
+void ShadowCache::render(glm::ivec2 frame, GLuint vertexbuffer) {
+	GLint outer = 0, previous = 0, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glm::ivec2 wanted = (frame + tile - 1) / tile;
+	if (wanted != size) {
+		if (FBO != 0) {
+			glDeleteFramebuffers(1, &FBO);
+			glDeleteTextures(1, &cache);
+		}
+		size = wanted;
+
+		glGenTextures(1, &cache);
+		glBindTexture(GL_TEXTURE_2D, cache);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size.x, size.y, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		// The slots go to the shader's second output, like the AO cache's.
+		const GLenum buffers[] = { GL_NONE, GL_COLOR_ATTACHMENT0 };
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cache, 0);
+		glDrawBuffers(2, buffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Shadow cache framebuffer %dx%d is incomplete\n", size.x, size.y);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, size.x, size.y);
+	glUseProgram(program);
+	drawScreen(vertexbuffer);
+
+	glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+	glBindTexture(GL_TEXTURE_2D, cache);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUseProgram(previous);
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+
+/*
+SHADOW CACHE:
+  With SHADOWS on, lighting() marches a soft shadow ray to each of the SHADOW_LIGHTS lights that light a primary hit the
+  most; the rest stay unshadowed, so many lights cost no more than a few. screen.frag built with SHADOW_PASS runs once
+  per tile x tile block of the screen, marches the ray through the tile's center and stores, for its own SHADOW_LIGHTS
+  lights, each one's index and visibility.
+
+  A pixel then looks at the four tiles around it. Where all of them saw a light about the same (SHADOW_AGREE in
+  screen.frag), fully unblocked, fully blocked or in the middle of a wide penumbra, the pixel interpolates theirs and
+  skips its own shadow ray. Only pixels at penumbra edges, on silhouettes and next to tiles that picked other lights
+  march. A shadow smaller than a tile that falls between tile centers can be missed, which is why the tile stays small.
+*/
+
+#define SHADOW_TILE 4
+#define SHADOW_UNIT 12
+
+class ShadowCache {
+public:
+	// defines should be the ones the screen program was built with, SHADOWS on among them.
+	ShadowCache(UniformBinding& uniforms, int tile = SHADOW_TILE, const char* defines = "");
+	~ShadowCache();
+
+	// Points a program's shadowCache sampler at the cache and tells it the tile size.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	// Renders the tiles for a wid x hei frame with the Frame and Lights blocks already uploaded, then puts the
+	// framebuffer, viewport and program back the way they were.
+	void render(glm::ivec2 frame, GLuint vertexbuffer);
+
+	// The tile pass, for the cone prepass, the brick map and the light buffer to attach to.
+	GLuint shader() const { return program; }
+
+private:
+	GLuint program = 0, FBO = 0, cache = 0;
+	int tile;
+	glm::ivec2 size = glm::ivec2(0);
+};
@@ -0,0 +1,166 @@
+#include "TemporalCache.h"
+#include <glm/glm.hpp>
+#include <stdio.h>
+
+static GLuint genTarget(GLenum format, GLenum filter, glm::ivec2 size) {
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, size.x, size.y, 0, GL_RGBA, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return tex;
+}
+
+TemporalCache::TemporalCache(UniformBinding& uniforms) {
+	splat = LoadShaders("reproject.vert", "reproject.frag");
+	uniforms.attach(splat);
+	attach(splat, uniforms);
+	staticsLoc = uniforms.location(splat, "staticMaterials");
+	staticMaterials(1);
+}
+TemporalCache::~TemporalCache() {
+	release();
+	glDeleteProgram(splat);
+}
+
+void TemporalCache::attach(GLuint program, const UniformBinding& uniforms) {
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(program);
+
+	GLint loc;
+	if ((loc = uniforms.location(program, "historyColor")) != -1)
+		glUniform1i(loc, TEMPORAL_COLOR_UNIT);
+	if ((loc = uniforms.location(program, "historyHit")) != -1)
+		glUniform1i(loc, TEMPORAL_HIT_UNIT);
+	if ((loc = uniforms.location(program, "reprojected")) != -1)
+		glUniform1i(loc, TEMPORAL_START_UNIT);
+
+	glUseProgram(previous);
+	if (program != splat)
+		screen = program;
+}
+
+void TemporalCache::staticMaterials(int count) {
+	if (count == statics)
+		return;
+	statics = count;
+	GLint previous = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+	glUseProgram(splat);
+	glUniform1f(staticsLoc, float(count));
+	glUseProgram(previous);
+}
+
+void TemporalCache::allocate(glm::ivec2 size) {
+	release();
+	this->size = size;
+
+	const GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	for (int i = 0; i < 2; i++) {
+		color[i] = genTarget(GL_RGBA16F, GL_LINEAR, size);
+		hit[i] = genTarget(GL_RGBA32F, GL_NEAREST, size);
+
+		glGenFramebuffers(1, &FBO[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color[i], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, hit[i], 0);
+		glDrawBuffers(2, buffers);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("Temporal framebuffer %dx%d is incomplete\n", size.x, size.y);
+	}
+
+	start = genTarget(GL_R32F, GL_NEAREST, size);
+	glGenRenderbuffers(1, &startDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, startDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y);
+
+	glGenFramebuffers(1, &startFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, startFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, start, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, startDepth);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		printf("Reprojection framebuffer %dx%d is incomplete\n", size.x, size.y);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+	valid = false;
+}
+
+void TemporalCache::release() {
+	if (startFBO == 0)
+		return;
+	glDeleteFramebuffers(2, FBO);
+	glDeleteTextures(2, color);
+	glDeleteTextures(2, hit);
+	glDeleteFramebuffers(1, &startFBO);
+	glDeleteTextures(1, &start);
+	glDeleteRenderbuffers(1, &startDepth);
+	startFBO = 0;
+}
+
+void TemporalCache::begin(FrameUniforms& u) {
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &outer);
+
+	glm::ivec2 wanted = glm::max(glm::ivec2(u.res), glm::ivec2(1));
+	if (wanted != size)
+		allocate(wanted);
+
+	u.prevCam = cam;
+	u.prevLook = look;
+	u.temporal = valid ? 1.0f : 0.0f;
+	u.frame = float(frame % 1024);
+
+	cam = u.cam;
+	look = u.look;
+}
+
+void TemporalCache::reproject() {
+	int history = 1 - current;
+
+	// Without history the start target stays cleared, so every ray marches from the camera.
+	glBindFramebuffer(GL_FRAMEBUFFER, startFBO);
+	glViewport(0, 0, size.x, size.y);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClearDepth(1.0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glActiveTexture(GL_TEXTURE0 + TEMPORAL_COLOR_UNIT);
+	glBindTexture(GL_TEXTURE_2D, color[history]);
+	glActiveTexture(GL_TEXTURE0 + TEMPORAL_HIT_UNIT);
+	glBindTexture(GL_TEXTURE_2D, hit[history]);
+
+	if (valid) {
+		glUseProgram(splat);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glEnable(GL_PROGRAM_POINT_SIZE);
+
+		glDrawArrays(GL_POINTS, 0, size.x * size.y);
+
+		glDisable(GL_PROGRAM_POINT_SIZE);
+		glDisable(GL_DEPTH_TEST);
+		glUseProgram(screen);
+	}
+
+	glActiveTexture(GL_TEXTURE0 + TEMPORAL_START_UNIT);
+	glBindTexture(GL_TEXTURE_2D, start);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO[current]);
+}
+
+void TemporalCache::end() {
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO[current]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outer);
+	glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, outer);
+
+	current = 1 - current;
+	valid = true;
+	frame++;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "Raymarching.h"
+#include "Uniforms.h"
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+
+/*
+TEMPORAL CACHE:
+  screen.frag writes its primary hit (world position and material) next to the color. The next frame reprojects those
+  hits instead of marching every primary ray from the camera:
+
+  - reproject() splats last frame's hits into the current view (reproject.vert). The nearest one that lands on a pixel,
+    pulled back a little, is where that pixel's primary ray starts marching, so a reused surface costs a few steps.
+    Pixels nothing lands on (disocclusion, screen edges) and pixels near animated objects start at 0 and march the full way.
+  - screen.frag then looks up where its own hit was last frame and, if the same static surface was there, blends the
+    accumulated color towards the new one (TEMPORAL_BLEND), with subpixel jitter so the history antialiases.
+  - A rotating quarter of the pixels march from the camera every frame regardless (TEMPORAL_REFRESH), which bounds how
+    long anything the reprojection can't see, like an object moving in front of a reused hit, stays wrong.
+
+  Two sets of targets ping-pong between history and current. The history is dropped whenever the render size changes.
+*/
+
+#define TEMPORAL_COLOR_UNIT 1
+#define TEMPORAL_HIT_UNIT 2
+#define TEMPORAL_START_UNIT 3
+
+class TemporalCache {
+public:
+	TemporalCache(UniformBinding& uniforms);
+	~TemporalCache();
+
+	// Points a program's history samplers at the cache's texture units. Also remembers it as the program reproject() returns to.
+	void attach(GLuint program, const UniformBinding& uniforms);
+
+	// Sizes the targets and fills in the previous camera of u. Call before uploading u.
+	void begin(FrameUniforms& u);
+	// Splats the history into the current view, then binds this frame's targets and the history textures for screen.frag.
+	void reproject();
+	// Copies this frame's color into the framebuffer that was bound at begin() and makes it the history.
+	void end();
+	// How many materials hold still, as ANIMATED() in screen.frag counts them: 1 for the built-in scene, a scene file's
+	// static ones otherwise. Splats of the others mark their area to be marched from the camera.
+	void staticMaterials(int count);
+
+private:
+	void allocate(glm::ivec2 size);
+	void release();
+
+	GLuint splat = 0, screen = 0;
+	GLint staticsLoc = -1;
+	int statics = 0;
+
+	GLuint FBO[2] = { 0, 0 }, color[2] = { 0, 0 }, hit[2] = { 0, 0 };
+	GLuint startFBO = 0, start = 0, startDepth = 0;
+	GLint outer = 0; // framebuffer to copy the result into
+
+	glm::ivec2 size = glm::ivec2(0);
+	int current = 0;
+	bool valid = false; // whether the other set holds a usable frame
+	long long frame = 0;
+
+	glm::vec3 cam = glm::vec3(0.0f), look = glm::vec3(0.0f, 0.0f, 1.0f);
+};
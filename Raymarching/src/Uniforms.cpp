@@ -0,0 +1,71 @@
+#include "Uniforms.h"
+#include <vector>
+#include <stdio.h>
+
+UniformBinding::UniformBinding() {
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, UBO);
+}
+UniformBinding::~UniformBinding() {
+	glDeleteBuffers(1, &UBO);
+}
+
+void UniformBinding::attach(GLuint program) {
+	GLuint block = glGetUniformBlockIndex(program, "Frame");
+	if (block != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, block, FRAME_BINDING);
+
+		GLint size = 0;
+		glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		if (size != (GLint)sizeof(FrameBlock))
+			printf("Frame block is %d bytes in the shader but %d in FrameBlock\n", size, (int)sizeof(FrameBlock));
+	}
+
+	auto& names = locations[program];
+	names.clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> name(maxLength + 1);
+	for (GLint i = 0; i < count; i++) {
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(program, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+
+		// Members of uniform blocks have no location.
+		GLint loc = glGetUniformLocation(program, name.data());
+		if (loc != -1)
+			names[name.data()] = loc;
+	}
+}
+
+GLint UniformBinding::location(GLuint program, const std::string& name) const {
+	auto p = locations.find(program);
+	if (p == locations.end())
+		return -1;
+	auto n = p->second.find(name);
+	return n == p->second.end() ? -1 : n->second;
+}
+
+void UniformBinding::upload(const FrameUniforms& u) {
+	FrameBlock block;
+	block.res = u.res;
+	block.time = float(u.time);
+	block.seed = u.seed;
+	block.cam = glm::vec4(u.cam, 0.0f);
+	block.look = glm::vec4(u.look, 0.0f);
+	block.prevCam = u.prevCam;
+	block.temporal = u.temporal;
+	block.prevLook = u.prevLook;
+	block.frame = u.frame;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
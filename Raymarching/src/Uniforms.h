@@ -0,0 +1,49 @@
+#pragma once
+#include "Raymarching.h"
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <string>
+#include <unordered_map>
+
+/*
+UNIFORM BINDING:
+  Per frame state lives in the std140 block 'Frame' (see screen.frag) and goes up with a single glBufferSubData.
+  The block sits on binding point FRAME_BINDING for every program that declares it.
+
+  Any loose uniforms a program still has are looked up once in attach() instead of by name every frame.
+*/
+
+#define FRAME_BINDING 0
+
+// std140 mirror of the Frame block. vec3s take a full 16 byte slot.
+struct FrameBlock {
+	glm::vec2 res;
+	float time;
+	float seed;
+
+	glm::vec4 cam;
+	glm::vec4 look;
+
+	// vec3 + float share a slot.
+	glm::vec3 prevCam;
+	float temporal;
+	glm::vec3 prevLook;
+	float frame;
+};
+
+class UniformBinding {
+public:
+	UniformBinding();
+	~UniformBinding();
+
+	// Resolves the Frame block and every loose uniform of a freshly linked program.
+	void attach(GLuint program);
+	// -1 if the program has no such active uniform.
+	GLint location(GLuint program, const std::string& name) const;
+
+	void upload(const FrameUniforms& u);
+
+private:
+	GLuint UBO;
+	std::unordered_map<GLuint, std::unordered_map<std::string, GLint>> locations;
+};